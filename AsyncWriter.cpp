@@ -0,0 +1,133 @@
+#include <algorithm>
+
+#include "AsyncWriter.h"
+
+
+AsyncWriter::AsyncWriter(std::unique_ptr<TrajectoryWriter> inWriter, std::size_t inMemoryBudget) :
+	TrajectoryWriter{ inWriter->fileName() }, m_writer{ std::move(inWriter) }, m_memoryBudget{ inMemoryBudget } {}
+
+AsyncWriter::~AsyncWriter() {
+	stop();
+}
+
+//A slot can hold a description of the bodies rather than their positions, so each is given room for whichever of the two is larger.
+void AsyncWriter::start(std::size_t inBodyCount) {
+	const std::size_t bytesPerBody{ std::max(3 * sizeof(double), sizeof(std::string) + sizeof(double)) };
+	const std::size_t snapshotBytes{ sizeof(Slot) + bytesPerBody * std::max<std::size_t>(inBodyCount, 1) };
+	m_slots.resize(std::clamp<std::size_t>(m_memoryBudget / snapshotBytes, 2, maxSlots));
+	m_thread = std::thread{ [this]() { writerLoop(); } };
+}
+
+void AsyncWriter::stop() {
+	if (!m_thread.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_stopping.store(true);
+	}
+	m_wake.notify_all();
+	m_thread.join();
+}
+
+void AsyncWriter::writerLoop() {
+	try {
+		for (;;) {
+			const std::size_t emptied{ m_emptied.load(std::memory_order_relaxed) };
+			if (m_filled.load(std::memory_order_acquire) == emptied) {
+				//Nothing to write, so sleep until the simulation publishes a slot. The flag tells it to wake us, and the check under the lock catches a slot
+				//published just before the flag was set.
+				std::unique_lock<std::mutex> lock{ m_mutex };
+				m_writerWaiting.store(true);
+				m_wake.wait(lock, [&]() { return m_filled.load() != emptied || m_stopping.load(); });
+				m_writerWaiting.store(false);
+				if (m_filled.load() == emptied) return;				//Stopping, with everything written.
+			}
+
+			Slot& slot{ m_slots[emptied % m_slots.size()] };
+			//A description's arrays are freed once written, as the slot goes back to holding positions.
+			if (slot.describesBodies) {
+				m_writer->writeBodies(slot.names, slot.masses);
+				slot.describesBodies = false;
+				slot.names = {};
+				slot.masses = {};
+			}
+			else m_writer->writeSnapshot(slot.time, slot.state);
+			m_emptied.store(emptied + 1);
+			wakeIfWaiting(m_simulationWaiting);
+		}
+	}
+	catch (...) {
+		//m_failed is set under the lock, as the simulation checks it under the lock before waiting. Set outside it, the flag and the notification could
+		//both fall between that check and the wait, and with this thread gone nothing would ever wake the simulation.
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			m_exception = std::current_exception();
+			m_failed.store(true);
+		}
+		m_wake.notify_all();
+	}
+}
+
+AsyncWriter::Slot& AsyncWriter::claimSlot() {
+	rethrowWriterException();
+	const std::size_t filled{ m_filled.load(std::memory_order_relaxed) };
+	if (filled - m_emptied.load(std::memory_order_acquire) == m_slots.size()) {
+		++m_stalls;
+		std::unique_lock<std::mutex> lock{ m_mutex };
+		m_simulationWaiting.store(true);
+		m_wake.wait(lock, [&]() { return filled - m_emptied.load() < m_slots.size() || m_failed.load(); });
+		m_simulationWaiting.store(false);
+		lock.unlock();
+		rethrowWriterException();
+	}
+	return m_slots[filled % m_slots.size()];
+}
+
+void AsyncWriter::publish() {
+	m_filled.fetch_add(1);
+	wakeIfWaiting(m_writerWaiting);
+}
+
+//The lock is only taken if the other side is asleep, or about to be. Taking it before notifying means the notification cannot fall between that side's
+//last look at the counters and its wait.
+void AsyncWriter::wakeIfWaiting(std::atomic<bool>& inWaiting) {
+	if (!inWaiting.load()) return;
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+	}
+	m_wake.notify_all();
+}
+
+void AsyncWriter::rethrowWriterException() {
+	//m_exception is never changed again once m_failed is set, so it can be read without the lock.
+	if (m_failed.load()) std::rethrow_exception(m_exception);
+}
+
+void AsyncWriter::writeBodies(const std::vector<std::string>& inNames, const alignedArray_t<double>& inMasses) {
+	if (!m_thread.joinable()) start(inNames.size());
+	Slot& slot{ claimSlot() };
+	slot.describesBodies = true;
+	slot.names = inNames;
+	slot.masses = inMasses;
+	publish();
+}
+
+void AsyncWriter::writeSnapshot(double inTime, const BodyState& inState) {
+	if (!m_thread.joinable()) start(inState.size());
+	Slot& slot{ claimSlot() };
+	slot.time = inTime;
+	slot.state.x.assign(inState.x.begin(), inState.x.end());
+	slot.state.y.assign(inState.y.begin(), inState.y.end());
+	slot.state.z.assign(inState.z.begin(), inState.z.end());
+	publish();
+}
+
+void AsyncWriter::finish() {
+	stop();
+	m_writer->finish();
+	rethrowWriterException();
+}
+
+void AsyncWriter::printStatistics(std::ostream& outStream) const {
+	outStream << "Output written on its own thread, through " << m_slots.size() << " snapshot slots. The simulation waited for the writer " << m_stalls << " times.\n";
+	m_writer->printStatistics(outStream);
+}
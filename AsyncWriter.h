@@ -0,0 +1,89 @@
+#ifndef AsyncWriter_H
+#define AsyncWriter_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Output.h"
+
+/*
+* A trajectory writer which hands every snapshot to another writer on a thread of its own, so that formatting and writing the output overlaps with the
+* simulation rather than holding up every step.
+*
+* The simulation copies each snapshot's positions into the next free slot of a ring buffer and carries on, and the writer thread empties slots in order.
+* There is only ever one thread filling slots and one emptying them, so the ring needs no lock: each side owns the slots between the two counters which
+* it alone moves forward, and the release and acquire on those counters make the slot contents visible to the other side. A mutex and condition variable
+* are only used to put a side to sleep when it has nothing to do, and are only touched when the other side is actually waiting.
+*
+* The ring holds as many snapshots as fit in the memory budget (outputMemory in config.txt, in MB), but no more than maxSlots. It is sized, and the writer
+* thread started, when the bodies are first described. If the writer falls that far behind, the simulation waits for a slot to free up rather than using
+* more memory, and the number of such waits is reported at the end of the run.
+* Descriptions of the bodies, written after merges, go through the ring too, so they stay in order with the snapshots around them. Only the names and
+* masses are copied into the slot, as they are all a writer needs.
+*
+* An exception thrown while writing, such as from a full disk, stops the writer thread, and is thrown again from every later call made to the writer.
+*/
+
+class AsyncWriter : public TrajectoryWriter
+{
+public:
+	static constexpr std::size_t maxSlots{ 4096 };
+
+private:
+	struct Slot {
+		double						 time{ 0 };
+		BodyState					 state;					//Only the positions are filled in.
+		bool						 describesBodies{ false };	//Set instead of a snapshot when the bodies are to be described, by the two below.
+		std::vector<std::string>	 names;
+		alignedArray_t<double>		 masses;
+	};
+
+	std::unique_ptr<TrajectoryWriter>	 m_writer;
+	std::size_t							 m_memoryBudget;
+	std::vector<Slot>					 m_slots;
+	//The number of slots ever filled and ever emptied. Each is only moved forward by one side, and their difference is the number of slots in use.
+	std::atomic<std::size_t>			 m_filled{ 0 };
+	std::atomic<std::size_t>			 m_emptied{ 0 };
+
+	std::mutex							 m_mutex;
+	std::condition_variable				 m_wake;
+	std::atomic<bool>					 m_writerWaiting{ false };
+	std::atomic<bool>					 m_simulationWaiting{ false };
+	std::atomic<bool>					 m_stopping{ false };
+	std::atomic<bool>					 m_failed{ false };			//Set once m_exception holds what stopped the writer thread.
+	std::exception_ptr					 m_exception;
+	std::size_t							 m_stalls{ 0 };			//How many times the simulation had to wait for a free slot.
+	std::thread							 m_thread;
+
+	void start(std::size_t inBodyCount);
+	void stop();
+	void writerLoop();
+	//Wait for a free slot and return it. The slot is only handed to the writer thread by publish().
+	Slot& claimSlot();
+	void publish();
+	void wakeIfWaiting(std::atomic<bool>& inWaiting);
+	void rethrowWriterException();
+
+public:
+	//Wrap inWriter, holding at most inMemoryBudget bytes of snapshots at a time.
+	AsyncWriter(std::unique_ptr<TrajectoryWriter> inWriter, std::size_t inMemoryBudget);
+	~AsyncWriter() override;
+
+	AsyncWriter(const AsyncWriter&) = delete;
+	AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+	void writeBodies(const std::vector<std::string>& inNames, const alignedArray_t<double>& inMasses) override;
+	void writeSnapshot(double inTime, const BodyState& inState) override;
+	void finish() override;
+	void printStatistics(std::ostream& outStream) const override;
+};
+
+
+#endif
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <vector>
+
+#include "BarnesHut.h"
+#include "ForceKernelsImpl.h"
+#include "Octree.h"
+
+
+BarnesHutSolver::BarnesHutSolver(double inTheta, bool inUseQuadrupole, ThreadPool& inPool, Softening inSoftening)
+	: ForceSolver{ inPool, inSoftening }, m_theta{ inTheta }, m_useQuadrupole{ inUseQuadrupole } {}
+
+namespace {
+
+//Precompute the square of each cell's opening radius, s/theta + delta, so that accepting a cell costs a single comparison.
+std::vector<double> openingRadii(const Octree& inTree, double inTheta) {
+	const std::vector<Octree::Node>& nodes{ inTree.nodes() };
+	std::vector<double> openingRadius2(nodes.size());
+	for (std::size_t n = 0; n < nodes.size(); ++n) {
+		const Octree::Node& node{ nodes[n] };
+		if (inTheta <= 0) {
+			openingRadius2[n] = std::numeric_limits<double>::infinity();
+			continue;
+		}
+		const double deltaX{ node.comX - node.centreX };
+		const double deltaY{ node.comY - node.centreY };
+		const double deltaZ{ node.comZ - node.centreZ };
+		const double radius{ 2 * node.halfSize / inTheta + std::sqrt(deltaX * deltaX + deltaY * deltaY + deltaZ * deltaZ) };
+		openingRadius2[n] = radius * radius;
+	}
+	return openingRadius2;
+}
+
+//Walk the tree from the root for a body at (xi, yi, zi), and return Sum( m g(r) d ) over every cell or body it interacts with. G is left to the caller.
+//g(r) is 1/r^3 unless softened. Cells are softened with the walking body's own softening length, and the quadrupole correction is never softened,
+//as an accepted cell is normally far beyond any softening length. inStack is only scratch space, passed in so that its memory is reused from one walk to the next.
+template<template<typename> class Softening>
+void walkTree(const Octree& inTree, const std::vector<double>& inOpeningRadius2, bool inUseQuadrupole, double xi, double yi, double zi, double inSoftening2,
+	std::vector<std::uint32_t>& inStack, double& outX, double& outY, double& outZ) {
+	const std::vector<Octree::Node>& nodes{ inTree.nodes() };
+	const double* x{ inTree.x().data() };
+	const double* y{ inTree.y().data() };
+	const double* z{ inTree.z().data() };
+	const double* mass{ inTree.masses().data() };
+	const double* softening2{ inTree.softening2().data() };
+	double sumX{ 0 };
+	double sumY{ 0 };
+	double sumZ{ 0 };
+
+	inStack.push_back(0);
+	while (!inStack.empty()) {
+		const std::uint32_t n{ inStack.back() };
+		inStack.pop_back();
+		const Octree::Node& node{ nodes[n] };
+
+		const double dx{ node.comX - xi };
+		const double dy{ node.comY - yi };
+		const double dz{ node.comZ - zi };
+		const double r2{ dx * dx + dy * dy + dz * dz };
+
+		if (r2 > inOpeningRadius2[n]) {
+			//Far enough away: the whole cell acts as one pseudo-body at its centre of mass.
+			const double invR{ 1.0 / std::sqrt(r2) };
+			const double invR2{ invR * invR };
+			const double invR3{ invR * invR2 };
+			double factor{ node.mass * invR3 };
+			if constexpr (Softening<ScalarOps>::usesLength) {
+				Softening<ScalarOps> pair;
+				factor = pair.factor(node.mass, r2, inSoftening2);
+			}
+			if (inUseQuadrupole) {
+				//The quadrupole correction to the acceleration is ( -Q.d / r^5 + (5/2) (d.Q.d) d / r^7 ), with d pointing from the body to the centre of mass.
+				const double qdX{ node.qxx * dx + node.qxy * dy + node.qxz * dz };
+				const double qdY{ node.qxy * dx + node.qyy * dy + node.qyz * dz };
+				const double qdZ{ node.qxz * dx + node.qyz * dy + node.qzz * dz };
+				const double invR5{ invR3 * invR2 };
+				const double dQd{ dx * qdX + dy * qdY + dz * qdZ };
+				factor += 2.5 * dQd * invR5 * invR2;
+				sumX -= qdX * invR5;
+				sumY -= qdY * invR5;
+				sumZ -= qdZ * invR5;
+			}
+			sumX += factor * dx;
+			sumY += factor * dy;
+			sumZ += factor * dz;
+		}
+		else if (node.isLeaf()) {
+			//Too close to approximate, and nothing left to open, so sum over the bodies directly.
+			for (std::uint32_t j = node.bodyBegin; j < node.bodyEnd; ++j) {
+				const double bx{ x[j] - xi };
+				const double by{ y[j] - yi };
+				const double bz{ z[j] - zi };
+				const double b2{ bx * bx + by * by + bz * bz };
+				if (b2 <= 0) continue;											//Skip this body itself.
+				double pairSoftening2{ 0 };
+				if constexpr (Softening<ScalarOps>::usesLength) pairSoftening2 = ScalarOps::max(inSoftening2, softening2[j]);
+				Softening<ScalarOps> pair;
+				const double bodyFactor{ pair.factor(mass[j], b2, pairSoftening2) };
+				sumX += bodyFactor * bx;
+				sumY += bodyFactor * by;
+				sumZ += bodyFactor * bz;
+			}
+		}
+		else {
+			for (std::uint32_t c = node.firstChild; c < node.firstChild + node.childCount; ++c) inStack.push_back(c);
+		}
+	}
+
+	outX = sumX;
+	outY = sumY;
+	outZ = sumZ;
+}
+
+//The walk for the given softening. Chosen once per force calculation, so the walks themselves carry no branch on it.
+using walk_t = void(*)(const Octree&, const std::vector<double>&, bool, double, double, double, double, std::vector<std::uint32_t>&, double&, double&, double&);
+walk_t walkFor(Softening inSoftening) {
+	switch (inSoftening) {
+	case Softening::plummer:	return &walkTree<PlummerSoftening>;
+	case Softening::spline:		return &walkTree<SplineSoftening>;
+	default:					return &walkTree<NoSoftening>;
+	}
+}
+
+}
+
+
+void BarnesHutSolver::computeAccelerations(const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc) const {
+	constexpr double G{ BodySystem::G };
+	const std::size_t count{ inState.size() };
+	const std::size_t activeCount{ inBodies.activeCount() };
+	outAcc.resize(count);
+	if (count == 0) return;
+
+	//The tree holds the massive bodies only. Test particles walk it like everything else, but would only add empty weight to its cells.
+	const Octree tree{ inBodies, inState, activeCount };
+	const std::vector<double> openingRadius2{ openingRadii(tree, m_theta) };
+	const walk_t walk{ walkFor(m_softening) };
+
+	//Walk the tree once per body, the massive ones in tree order so consecutive walks visit much the same cells, and then the test particles in the order they are stored.
+	//Each block of bodies has a stack of its own.
+	m_pool->parallelFor(count, 64, [&](std::size_t inBegin, std::size_t inEnd) {
+		std::vector<std::uint32_t> stack;
+		stack.reserve(64);
+		for (std::size_t k = inBegin; k < inEnd; ++k) {
+			double sumX;
+			double sumY;
+			double sumZ;
+			std::size_t i{ k };
+			if (k < activeCount) {
+				walk(tree, openingRadius2, m_useQuadrupole, tree.x()[k], tree.y()[k], tree.z()[k], tree.softening2()[k], stack, sumX, sumY, sumZ);
+				i = tree.order()[k];												//Write the result back to the body's original index.
+			}
+			else {
+				walk(tree, openingRadius2, m_useQuadrupole, inState.x[k], inState.y[k], inState.z[k], inBodies.softening2()[k], stack, sumX, sumY, sumZ);
+			}
+			outAcc.ax[i] = G * sumX;
+			outAcc.ay[i] = G * sumY;
+			outAcc.az[i] = G * sumZ;
+		}
+	});
+}
+//The tree still has to be built over every massive body, but only the listed bodies walk it.
+void BarnesHutSolver::computeSubsetAccelerations(const BodySystem& inBodies, const BodyState& inState, const std::vector<std::uint32_t>& inTargets, AccelerationBuffer& outAcc) const {
+	constexpr double G{ BodySystem::G };
+	if (inTargets.empty()) return;
+
+	const Octree tree{ inBodies, inState, inBodies.activeCount() };
+	const std::vector<double> openingRadius2{ openingRadii(tree, m_theta) };
+	const walk_t walk{ walkFor(m_softening) };
+
+	m_pool->parallelFor(inTargets.size(), 64, [&](std::size_t inBegin, std::size_t inEnd) {
+		std::vector<std::uint32_t> stack;
+		stack.reserve(64);
+		for (std::size_t k = inBegin; k < inEnd; ++k) {
+			const std::uint32_t i{ inTargets[k] };
+			double sumX;
+			double sumY;
+			double sumZ;
+			walk(tree, openingRadius2, m_useQuadrupole, inState.x[i], inState.y[i], inState.z[i], inBodies.softening2()[i], stack, sumX, sumY, sumZ);
+			outAcc.ax[i] = G * sumX;
+			outAcc.ay[i] = G * sumY;
+			outAcc.az[i] = G * sumZ;
+		}
+	});
+}
+std::string_view BarnesHutSolver::name() const {
+	return "barnesHut";
+}
+
+
+void reportBarnesHutAccuracy(const BodySystem& inBodies, std::ostream& outStream, ThreadPool& inPool) {
+	using steadyClock = std::chrono::steady_clock;
+	const std::size_t count{ inBodies.size() };
+
+	//The reference solution.
+	AccelerationBuffer reference;
+	const DirectSolver direct{ inPool };
+	const auto directStart{ steadyClock::now() };
+	direct.computeAccelerations(inBodies, inBodies.state(), reference);
+	const std::chrono::duration<double, std::milli> directTime{ steadyClock::now() - directStart };
+
+	outStream << "Barnes-Hut accuracy report for " << count << " bodies. Direct summation took " << directTime.count() << " ms.\n";
+	outStream << "Errors are |a_tree - a_direct| / |a_direct| per body.\n";
+	outStream << std::setw(8) << "theta" << std::setw(12) << "moments" << std::setw(16) << "RMS error" << std::setw(16) << "max error" << std::setw(14) << "time (ms)" << '\n';
+
+	AccelerationBuffer approx;
+	for (const double theta : { 0.1, 0.2, 0.3, 0.5, 0.7, 1.0 }) {
+		for (const bool quadrupole : { false, true }) {
+			const BarnesHutSolver tree{ theta, quadrupole, inPool };
+			const auto treeStart{ steadyClock::now() };
+			tree.computeAccelerations(inBodies, inBodies.state(), approx);
+			const std::chrono::duration<double, std::milli> treeTime{ steadyClock::now() - treeStart };
+
+			double sumSquares{ 0 };
+			double maxError{ 0 };
+			for (std::size_t i = 0; i < count; ++i) {
+				const double errX{ approx.ax[i] - reference.ax[i] };
+				const double errY{ approx.ay[i] - reference.ay[i] };
+				const double errZ{ approx.az[i] - reference.az[i] };
+				const double magnitude{ std::sqrt(reference.ax[i] * reference.ax[i] + reference.ay[i] * reference.ay[i] + reference.az[i] * reference.az[i]) };
+				if (magnitude <= 0) continue;
+				const double error{ std::sqrt(errX * errX + errY * errY + errZ * errZ) / magnitude };
+				sumSquares += error * error;
+				maxError = std::max(maxError, error);
+			}
+			const double rmsError{ count > 0 ? std::sqrt(sumSquares / static_cast<double>(count)) : 0 };
+
+			outStream << std::setw(8) << theta << std::setw(12) << (quadrupole ? "quadrupole" : "monopole")
+				<< std::setw(16) << rmsError << std::setw(16) << maxError << std::setw(14) << treeTime.count() << '\n';
+		}
+	}
+}
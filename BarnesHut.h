@@ -0,0 +1,48 @@
+#ifndef BarnesHut_H
+#define BarnesHut_H
+
+#include <ostream>
+
+#include "ForceSolver.h"
+
+/*
+* The Barnes-Hut tree solver. Rather than summing every pair, space is divided into an octree and a distant group of bodies is treated as a single
+* pseudo-body at its centre of mass. This brings the cost of a force evaluation down from O(N^2) to O(N log N).
+*
+* The tree (see Octree.h) is rebuilt from scratch on every call, as the bodies will have moved since the last one.
+* Whether a cell is far enough away to be approximated is decided by the opening angle theta: a cell of side s whose centre of mass lies a distance d away
+* is accepted if d > s/theta + delta, where delta is the offset of the centre of mass from the cell's geometric centre.
+* The delta term guards against the classic failure case of a body sitting just inside the edge of a large, lopsided cell.
+* Smaller values of theta are more accurate and slower; theta = 0 opens every cell and reproduces direct summation.
+*
+* Each cell carries its mass and centre of mass (the monopole), and optionally its quadrupole moment, which makes each accepted cell considerably more accurate
+* for a small extra cost per interaction.
+*
+* Softening applies to the bodies summed directly and to the monopole of each accepted cell, which is softened with the length of the body walking the tree.
+*
+* Only the massive bodies go into the tree. Test particles are left out of it, and simply walk it as extra targets, so a swarm of them costs one walk each.
+*
+* Once the tree is built, the walks of different bodies are independent of one another, so blocks of bodies are shared out between the threads of the pool.
+*/
+
+class BarnesHutSolver : public ForceSolver
+{
+private:
+	double		 m_theta{ 0.5 };
+	bool		 m_useQuadrupole{ false };
+
+public:
+	explicit BarnesHutSolver(double inTheta = 0.5, bool inUseQuadrupole = false, ThreadPool& inPool = ThreadPool::serial(), Softening inSoftening = Softening::none);
+
+	void computeAccelerations(const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc) const override;
+	void computeSubsetAccelerations(const BodySystem& inBodies, const BodyState& inState, const std::vector<std::uint32_t>& inTargets, AccelerationBuffer& outAcc) const override;
+	std::string_view name() const override;
+};
+
+
+//Compare the Barnes-Hut solver against direct summation for a range of opening angles, with and without quadrupoles,
+//and print the force errors and timings for the given system. Every solver shares its work over inPool.
+void reportBarnesHutAccuracy(const BodySystem& inBodies, std::ostream& outStream, ThreadPool& inPool = ThreadPool::serial());
+
+
+#endif
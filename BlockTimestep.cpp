@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cmath>
+
+#include "BlockTimestep.h"
+
+namespace {
+	constexpr std::size_t updateGrain{ 4096 };
+}
+
+
+BlockTimestepIntegrator::BlockTimestepIntegrator(double inAccuracy, ThreadPool& inPool) : Integrator{ inPool }, m_accuracy{ inAccuracy } {}
+
+BlockTimestepIntegrator::tick_t BlockTimestepIntegrator::ticksInLevel(std::size_t inLevel) {
+	return ticksPerStep >> inLevel;
+}
+
+void BlockTimestepIntegrator::initialise(BodySystem& inBodies, const ForceSolver& inSolver) {
+	computeAccelerations(inSolver, inBodies);
+	m_level.assign(inBodies.size(), static_cast<std::uint8_t>(maxLevel));
+	m_levelCount.fill(0);
+	m_levelCount[maxLevel] = inBodies.size();
+	m_newAcc.resize(inBodies.size());
+	m_initialised = true;
+}
+
+//Half a kick for one body, v += a dt/2.
+void BlockTimestepIntegrator::kick(BodySystem& inBodies, const AccelerationBuffer& inAcc, std::uint32_t inBody, double inTime) {
+	BodyState& state{ inBodies.state() };
+	state.vx[inBody] += inAcc.ax[inBody] * inTime;
+	state.vy[inBody] += inAcc.ay[inBody] * inTime;
+	state.vz[inBody] += inAcc.az[inBody] * inTime;
+}
+
+void BlockTimestepIntegrator::step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) {
+	if (!m_initialised) initialise(inBodies, inSolver);
+	const std::size_t count{ inBodies.size() };
+	const double tickLength{ inTimeStep / static_cast<double>(ticksPerStep) };
+	BodyState& state{ inBodies.state() };
+	AccelerationBuffer& acc{ inBodies.accelerations() };
+
+	//Every body is in line at the start of the step, so each opens its first step with a half kick using the accelerations from the end of the last.
+	m_pool->parallelFor(count, updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		for (std::size_t i = inBegin; i < inEnd; ++i) {
+			kick(inBodies, acc, static_cast<std::uint32_t>(i), 0.5 * tickLength * static_cast<double>(ticksInLevel(m_level[i])));
+		}
+	});
+
+	tick_t now{ 0 };
+	while (now < ticksPerStep) {
+		//The next time any body's step ends is set by the shortest bin in use.
+		std::size_t shortestLevel{ 0 };
+		for (std::size_t level = 0; level <= maxLevel; ++level) {
+			if (m_levelCount[level] > 0) shortestLevel = level;
+		}
+		const tick_t shortestTicks{ ticksInLevel(shortestLevel) };
+		const tick_t next{ (now / shortestTicks + 1) * shortestTicks };
+
+		//Drift everyone to that time.
+		const double drift{ tickLength * static_cast<double>(next - now) };
+		m_pool->parallelFor(count, updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+			for (std::size_t i = inBegin; i < inEnd; ++i) {
+				state.x[i] += state.vx[i] * drift;
+				state.y[i] += state.vy[i] * drift;
+				state.z[i] += state.vz[i] * drift;
+			}
+		});
+		now = next;
+
+		//The bodies whose steps end now.
+		m_active.clear();
+		for (std::size_t i = 0; i < count; ++i) {
+			if (now % ticksInLevel(m_level[i]) == 0) m_active.push_back(static_cast<std::uint32_t>(i));
+		}
+		if (m_active.size() == count) computeAccelerations(inSolver, inBodies, state, m_newAcc);
+		else computeSubsetAccelerations(inSolver, inBodies, state, m_active, m_newAcc);
+		m_bodyUpdates += m_active.size();
+
+		//Close each active body's step, choose its next one, and open that. At the end of the whole step every body is active, and is left in line with the rest.
+		m_pool->parallelFor(m_active.size(), updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+			for (std::size_t k = inBegin; k < inEnd; ++k) {
+				const std::uint32_t i{ m_active[k] };
+				const std::size_t oldLevel{ m_level[i] };
+				const double oldStep{ tickLength * static_cast<double>(ticksInLevel(oldLevel)) };
+				kick(inBodies, m_newAcc, i, 0.5 * oldStep);
+
+				//The jerk from the change in acceleration across the step, and from it the ideal step length.
+				const double jerkX{ (m_newAcc.ax[i] - acc.ax[i]) / oldStep };
+				const double jerkY{ (m_newAcc.ay[i] - acc.ay[i]) / oldStep };
+				const double jerkZ{ (m_newAcc.az[i] - acc.az[i]) / oldStep };
+				const double jerk{ std::sqrt(jerkX * jerkX + jerkY * jerkY + jerkZ * jerkZ) };
+				const double accel{ std::sqrt(m_newAcc.ax[i] * m_newAcc.ax[i] + m_newAcc.ay[i] * m_newAcc.ay[i] + m_newAcc.az[i] * m_newAcc.az[i]) };
+				std::size_t newLevel{ 0 };
+				if (jerk > 0) {
+					const double idealStep{ m_accuracy * accel / jerk };
+					const double levels{ std::ceil(std::log2(inTimeStep / idealStep)) };
+					newLevel = levels <= 0 ? 0 : static_cast<std::size_t>(std::min(levels, static_cast<double>(maxLevel)));
+				}
+
+				//Moving to a longer step is done one bin at a time, and only where the longer step would start now.
+				if (newLevel < oldLevel) {
+					newLevel = oldLevel - 1;
+					if (now % ticksInLevel(newLevel) != 0) newLevel = oldLevel;
+				}
+				m_level[i] = static_cast<std::uint8_t>(newLevel);
+
+				acc.ax[i] = m_newAcc.ax[i];
+				acc.ay[i] = m_newAcc.ay[i];
+				acc.az[i] = m_newAcc.az[i];
+				if (now < ticksPerStep) kick(inBodies, acc, i, 0.5 * tickLength * static_cast<double>(ticksInLevel(newLevel)));
+			}
+		});
+
+		m_levelCount.fill(0);
+		for (const std::uint8_t level : m_level) ++m_levelCount[level];
+	}
+	++m_steps;
+}
+
+void BlockTimestepIntegrator::reset() {
+	m_initialised = false;
+}
+std::string_view BlockTimestepIntegrator::name() const {
+	return "block";
+}
+void BlockTimestepIntegrator::printStatistics(std::ostream& outStream) const {
+	Integrator::printStatistics(outStream);
+	const std::size_t count{ m_level.size() };
+	if (count == 0) return;
+	outStream << "Body force calculations: " << m_bodyUpdates << ", the same work as " << static_cast<double>(m_bodyUpdates) / static_cast<double>(count)
+		<< " force calculations of every body.\n";
+	outStream << "Bodies in each time bin (bin: count):";
+	for (std::size_t level = 0; level <= maxLevel; ++level) {
+		if (m_levelCount[level] > 0) outStream << ' ' << level << ": " << m_levelCount[level];
+	}
+	outStream << '\n';
+}
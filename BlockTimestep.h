@@ -0,0 +1,62 @@
+#ifndef BlockTimestep_H
+#define BlockTimestep_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Integrator.h"
+
+/*
+* A kick-drift-kick leapfrog in which every body has a time step of its own, chosen from a hierarchy of power-of-two "time bins".
+*
+* A body in bin k takes steps of timeStep / 2^k, so bin 0 is the time step from config.txt and each bin below it is half the one above. Because every step length divides
+* every longer one, bodies in different bins still come back into line with each other regularly, and all of them line up at the end of each timeStep.
+*
+* Between those points the integrator jumps from one time to the next at which any body's step ends. Every body is drifted to that time, which is cheap,
+* but only the bodies whose steps end there (the "active" ones) have their forces recalculated and are kicked. Mercury can then take a thousand steps
+* for every one Pluto takes, rather than everything moving at Mercury's pace.
+*
+* A body's ideal step is eta |a| / |da/dt|, the time over which its acceleration changes appreciably, where eta is timestepAccuracy in config.txt.
+* The rate of change of the acceleration (the jerk) is estimated from the change in acceleration across the body's last step. A body is put in the longest bin
+* whose step is no longer than that. It can move to a shorter step at any time, but only moves up one bin at a time, and only when its step lines up with the longer one.
+* Bodies start in the shortest bin, as nothing is known about their jerk at first, and work their way up.
+*
+* A body's step is never shorter than timeStep / 2^maxLevel. Force solvers which can calculate the forces on only some bodies do much less work per substep
+* (see ForceSolver::computeSubsetAccelerations); the others still calculate every body's forces, and gain only from the bodies which are not kicked.
+*/
+
+class BlockTimestepIntegrator : public Integrator
+{
+public:
+	static constexpr std::size_t maxLevel{ 24 };
+
+private:
+	//Time is counted in integer ticks of timeStep / 2^maxLevel, so that deciding which bins are active involves no rounding.
+	using tick_t = std::uint64_t;
+	static constexpr tick_t ticksPerStep{ tick_t{ 1 } << maxLevel };
+
+	double								 m_accuracy{ 0.02 };
+	bool								 m_initialised{ false };
+	std::vector<std::uint8_t>			 m_level;						//The time bin of each body.
+	std::array<std::size_t, maxLevel + 1>	 m_levelCount{};			//How many bodies are in each bin.
+	AccelerationBuffer					 m_newAcc;						//The accelerations of the active bodies at the end of their steps.
+	std::vector<std::uint32_t>			 m_active;
+	std::size_t							 m_bodyUpdates{ 0 };			//The total number of body force calculations, for the statistics.
+
+	static tick_t ticksInLevel(std::size_t inLevel);
+	void initialise(BodySystem& inBodies, const ForceSolver& inSolver);
+	void kick(BodySystem& inBodies, const AccelerationBuffer& inAcc, std::uint32_t inBody, double inTime);
+
+public:
+	explicit BlockTimestepIntegrator(double inAccuracy = 0.02, ThreadPool& inPool = ThreadPool::serial());
+
+	void step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) override;
+	void reset() override;
+	std::string_view name() const override;
+	void printStatistics(std::ostream& outStream) const override;
+};
+
+
+#endif
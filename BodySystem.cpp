@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <utility>
+
+#include "BodySystem.h"
+
+using vector3D_t = dp::PhysicsVector<3>;
+using planetArray_t = std::vector<Planet>;
+
+//State buffers
+void BodyState::resize(std::size_t inSize) {
+	x.resize(inSize);
+	y.resize(inSize);
+	z.resize(inSize);
+	vx.resize(inSize);
+	vy.resize(inSize);
+	vz.resize(inSize);
+}
+std::size_t BodyState::size() const {
+	return x.size();
+}
+
+void AccelerationBuffer::resize(std::size_t inSize) {
+	ax.resize(inSize);
+	ay.resize(inSize);
+	az.resize(inSize);
+}
+std::size_t AccelerationBuffer::size() const {
+	return ax.size();
+}
+
+
+//Constructors
+BodySystem::BodySystem(const planetArray_t& inPlanets, const double inSoftening) {
+	reserve(inPlanets.size());
+	for (const auto& planet : inPlanets) {
+		addBody(planet, inSoftening);
+	}
+}
+
+//A massive body is inserted just after the last massive one, which is the end of the arrays unless there are test particles already.
+void BodySystem::addBody(const std::string& inName, const double inMass, const vector3D_t& inPos, const vector3D_t& inVel, const double inSoftening) {
+	const std::size_t index{ inMass > 0 ? m_activeCount : size() };
+	m_state.x.insert(m_state.x.begin() + index, inPos.x());
+	m_state.y.insert(m_state.y.begin() + index, inPos.y());
+	m_state.z.insert(m_state.z.begin() + index, inPos.z());
+	m_state.vx.insert(m_state.vx.begin() + index, inVel.x());
+	m_state.vy.insert(m_state.vy.begin() + index, inVel.y());
+	m_state.vz.insert(m_state.vz.begin() + index, inVel.z());
+	m_acceleration.ax.insert(m_acceleration.ax.begin() + index, 0.0);
+	m_acceleration.ay.insert(m_acceleration.ay.begin() + index, 0.0);
+	m_acceleration.az.insert(m_acceleration.az.begin() + index, 0.0);
+	m_mass.insert(m_mass.begin() + index, inMass);
+	m_softening2.insert(m_softening2.begin() + index, inSoftening * inSoftening);
+	m_names.insert(m_names.begin() + index, inName);
+	if (inMass > 0) ++m_activeCount;
+}
+void BodySystem::addBody(const Planet& inPlanet, const double inSoftening) {
+	const std::size_t index{ inPlanet.getMass() > 0 ? m_activeCount : size() };
+	addBody(inPlanet.getName(), inPlanet.getMass(), inPlanet.getPosition(), inPlanet.getVelocity(), inSoftening);
+	(*this)[index].setAcceleration(inPlanet.getAcceleration());
+}
+void BodySystem::removeBody(std::size_t inIndex) {
+	m_state.x.erase(m_state.x.begin() + inIndex);
+	m_state.y.erase(m_state.y.begin() + inIndex);
+	m_state.z.erase(m_state.z.begin() + inIndex);
+	m_state.vx.erase(m_state.vx.begin() + inIndex);
+	m_state.vy.erase(m_state.vy.begin() + inIndex);
+	m_state.vz.erase(m_state.vz.begin() + inIndex);
+	m_acceleration.ax.erase(m_acceleration.ax.begin() + inIndex);
+	m_acceleration.ay.erase(m_acceleration.ay.begin() + inIndex);
+	m_acceleration.az.erase(m_acceleration.az.begin() + inIndex);
+	m_mass.erase(m_mass.begin() + inIndex);
+	m_softening2.erase(m_softening2.begin() + inIndex);
+	m_names.erase(m_names.begin() + inIndex);
+	if (inIndex < m_activeCount) --m_activeCount;
+}
+void BodySystem::reserve(std::size_t inSize) {
+	m_state.x.reserve(inSize);
+	m_state.y.reserve(inSize);
+	m_state.z.reserve(inSize);
+	m_state.vx.reserve(inSize);
+	m_state.vy.reserve(inSize);
+	m_state.vz.reserve(inSize);
+	m_acceleration.ax.reserve(inSize);
+	m_acceleration.ay.reserve(inSize);
+	m_acceleration.az.reserve(inSize);
+	m_mass.reserve(inSize);
+	m_softening2.reserve(inSize);
+	m_names.reserve(inSize);
+}
+std::size_t BodySystem::size() const {
+	return m_mass.size();
+}
+bool BodySystem::empty() const {
+	return m_mass.empty();
+}
+std::size_t BodySystem::activeCount() const {
+	return m_activeCount;
+}
+std::size_t BodySystem::testParticleCount() const {
+	return size() - m_activeCount;
+}
+
+std::size_t BodySystem::makeLightBodiesPassive(double inMassFraction, bool inAbsorbMass) {
+	if (inMassFraction <= 0 || m_activeCount == 0) return 0;
+	double totalMass{ 0 };
+	std::size_t heaviest{ 0 };
+	for (std::size_t i = 0; i < m_activeCount; ++i) {
+		totalMass += m_mass[i];
+		if (m_mass[i] > m_mass[heaviest]) heaviest = i;
+	}
+	const double threshold{ inMassFraction * totalMass };
+
+	//The bodies staying massive come first, then those being made passive, then the test particles which were already there.
+	std::vector<std::size_t> order;
+	order.reserve(size());
+	std::vector<std::size_t> passive;
+	double passiveMass{ 0 };
+	for (std::size_t i = 0; i < m_activeCount; ++i) {
+		if (i == heaviest || m_mass[i] >= threshold) order.push_back(i);
+		else {
+			passive.push_back(i);
+			passiveMass += m_mass[i];
+		}
+	}
+	if (passive.empty()) return 0;
+	order.insert(order.end(), passive.begin(), passive.end());
+	for (std::size_t i = m_activeCount; i < size(); ++i) order.push_back(i);
+
+	if (inAbsorbMass) m_mass[heaviest] += passiveMass;
+	for (const std::size_t i : passive) m_mass[i] = 0;
+	reorder(order);
+	m_activeCount -= passive.size();
+	return passive.size();
+}
+
+void BodySystem::reorder(const std::vector<std::size_t>& inOrder) {
+	const auto permute{ [&inOrder](auto& inArray) {
+		auto reordered{ inArray };
+		for (std::size_t k = 0; k < inOrder.size(); ++k) reordered[k] = std::move(inArray[inOrder[k]]);
+		inArray.swap(reordered);
+	} };
+	permute(m_state.x);
+	permute(m_state.y);
+	permute(m_state.z);
+	permute(m_state.vx);
+	permute(m_state.vy);
+	permute(m_state.vz);
+	permute(m_acceleration.ax);
+	permute(m_acceleration.ay);
+	permute(m_acceleration.az);
+	permute(m_mass);
+	permute(m_softening2);
+	permute(m_names);
+}
+
+
+//Getters
+BodyState& BodySystem::state() {
+	return m_state;
+}
+const BodyState& BodySystem::state() const {
+	return m_state;
+}
+BodyState& BodySystem::nextState() {
+	m_nextState.resize(m_state.size());
+	return m_nextState;
+}
+void BodySystem::advanceState() {
+	std::swap(m_state, m_nextState);
+}
+AccelerationBuffer& BodySystem::accelerations() {
+	return m_acceleration;
+}
+const AccelerationBuffer& BodySystem::accelerations() const {
+	return m_acceleration;
+}
+const alignedArray_t<double>& BodySystem::masses() const {
+	return m_mass;
+}
+const alignedArray_t<double>& BodySystem::softening2() const {
+	return m_softening2;
+}
+void BodySystem::setSoftening(double inLength) {
+	std::fill(m_softening2.begin(), m_softening2.end(), inLength * inLength);
+}
+const std::vector<std::string>& BodySystem::names() const {
+	return m_names;
+}
+
+BodySystem::PlanetView BodySystem::operator[](std::size_t inIndex) {
+	return PlanetView(*this, inIndex);
+}
+BodySystem::ConstPlanetView BodySystem::operator[](std::size_t inIndex) const {
+	return ConstPlanetView(*this, inIndex);
+}
+
+
+//System-wide functions
+
+//The centre of mass is given by Sum(mass_n * position_n)/Sum(mass_n), computed on a per-component basis.
+vector3D_t BodySystem::centreOfMass() const {
+	double comX{ 0 };
+	double comY{ 0 };
+	double comZ{ 0 };
+	double totalMass{ 0 };
+	for (std::size_t i = 0; i < size(); ++i) {
+		comX += m_state.x[i] * m_mass[i];		//Sum the individual mass*position terms for the numerator
+		comY += m_state.y[i] * m_mass[i];
+		comZ += m_state.z[i] * m_mass[i];
+		totalMass += m_mass[i];					//Sum the masses for the denominator
+	}
+	return { comX / totalMass, comY / totalMass, comZ / totalMass };
+}
+void BodySystem::shiftOrigin(const vector3D_t& inNewOrigin) {
+	const double originX{ inNewOrigin.x() };
+	const double originY{ inNewOrigin.y() };
+	const double originZ{ inNewOrigin.z() };
+	for (std::size_t i = 0; i < size(); ++i) {
+		m_state.x[i] -= originX;
+		m_state.y[i] -= originY;
+		m_state.z[i] -= originZ;
+	}
+}
+
+//As with the position, the velocity of the centre of mass is the mass-weighted mean of the individual velocities.
+vector3D_t BodySystem::centreOfMassVelocity() const {
+	double comVX{ 0 };
+	double comVY{ 0 };
+	double comVZ{ 0 };
+	double totalMass{ 0 };
+	for (std::size_t i = 0; i < size(); ++i) {
+		comVX += m_state.vx[i] * m_mass[i];
+		comVY += m_state.vy[i] * m_mass[i];
+		comVZ += m_state.vz[i] * m_mass[i];
+		totalMass += m_mass[i];
+	}
+	return { comVX / totalMass, comVY / totalMass, comVZ / totalMass };
+}
+void BodySystem::moveToCentreOfMassFrame() {
+	const vector3D_t comVelocity{ centreOfMassVelocity() };
+	shiftOrigin(centreOfMass());
+	for (std::size_t i = 0; i < size(); ++i) {
+		m_state.vx[i] -= comVelocity.x();
+		m_state.vy[i] -= comVelocity.y();
+		m_state.vz[i] -= comVelocity.z();
+	}
+}
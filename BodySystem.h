@@ -0,0 +1,216 @@
+#ifndef BodySystem_H
+#define BodySystem_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "PhysicsVector.h"
+#include "AlignedAllocator.h"
+#include "Planet.h"
+
+/*
+* A structure-of-arrays container holding every body in the simulation.
+* Where a std::vector<Planet> interleaves each body's name, vtable pointer and three PhysicsVectors, here each component lives in its own contiguous, aligned array.
+* This means a force evaluation only ever touches the positions and masses it actually needs, and the arrays can be fed straight into vectorised kernels.
+* Names are only read when writing output, so they are kept in a separate "cold" array off to the side.
+*
+* Individual bodies can still be accessed through the Planet-like views returned by operator[], so code written against the Planet interface keeps working.
+*
+* Bodies with zero mass are test particles: they feel the pull of the massive bodies but pull on nothing themselves, as with asteroids and comets around the planets.
+* They are always kept at the end of the arrays, after every massive body, so the first activeCount() bodies are the only ones a force solver needs as sources.
+* With N massive bodies and M test particles, a force evaluation then costs N(N + M) pair interactions rather than (N + M)^2.
+* Adding a massive body after some test particles inserts it in front of them, so bodies are not always stored in the order they were added.
+*/
+
+//The phase space coordinates of every body. Kept as its own object so that integrators can hold scratch copies of the state without duplicating masses or names.
+struct BodyState {
+	alignedArray_t<double> x, y, z;					//Positions, measured in m.
+	alignedArray_t<double> vx, vy, vz;				//Velocities, measured in m/s.
+
+	void resize(std::size_t inSize);
+	std::size_t size() const;
+};
+
+//The acceleration of every body, measured in m/s^2.
+struct AccelerationBuffer {
+	alignedArray_t<double> ax, ay, az;
+
+	void resize(std::size_t inSize);
+	std::size_t size() const;
+};
+
+class BodySystem;
+
+//A lightweight stand-in for a Planet which refers to one body in a BodySystem rather than owning its data.
+//Instantiated with a const BodySystem, only the getters are usable.
+template<typename SystemType>
+class BasicPlanetView
+{
+	using vector3D_t = dp::PhysicsVector<3>;
+private:
+	SystemType*		 m_system;
+	std::size_t		 m_index;
+
+public:
+	BasicPlanetView(SystemType& inSystem, std::size_t inIndex) : m_system{ &inSystem }, m_index{ inIndex } {}
+
+	//Getters and setters, mirroring those of Planet. Vectors are returned by value as they are assembled from three separate arrays.
+	double getMass() const;
+	vector3D_t getPosition() const;
+	vector3D_t getVelocity() const;
+	vector3D_t getAcceleration() const;
+	const std::string& getName() const;
+
+	//Changing a mass does not move a body between the massive bodies and the test particles. A massive body given zero mass simply pulls on nothing,
+	//but a test particle given a mass is still not treated as a source.
+	void setMass(double inMass) const;
+	void setPosition(const vector3D_t& inPos) const;
+	void setVelocity(const vector3D_t& inVel) const;
+	void setAcceleration(const vector3D_t& inAcc) const;
+	void setName(const std::string& inName) const;
+
+	//Copy the body out into a standalone Planet object.
+	Planet toPlanet() const;
+};
+
+class BodySystem
+{
+	using vector3D_t = dp::PhysicsVector<3>;
+	using planetArray_t = std::vector<Planet>;
+public:
+	static constexpr double G{ 6.67408e-11 };				//The gravitational constant, as in Planet.
+
+	using PlanetView = BasicPlanetView<BodySystem>;
+	using ConstPlanetView = BasicPlanetView<const BodySystem>;
+
+private:
+	BodyState					 m_state;					//Positions and velocities at the current time.
+	BodyState					 m_nextState;				//Where each step writes the positions and velocities at the next time, before the two are swapped.
+	AccelerationBuffer			 m_acceleration;			//Accelerations.
+	alignedArray_t<double>		 m_mass;					//Masses, measured in kg.
+	alignedArray_t<double>		 m_softening2;				//The square of each body's softening length (see ForceKernels.h), measured in m^2.
+	std::vector<std::string>	 m_names;					//The cold side table of names. Only read when writing output.
+	std::size_t					 m_activeCount{ 0 };		//The number of massive bodies, which come before the test particles.
+
+	//Rearrange every per-body array so that body inOrder[k] ends up at index k.
+	void reorder(const std::vector<std::size_t>& inOrder);
+
+public:
+	//Constructors
+	BodySystem() = default;
+	//Every planet is given the same softening length, inSoftening, in m.
+	BodySystem(const planetArray_t& inPlanets, const double inSoftening);
+
+	//Add a single body to the system. Test particles go at the end, and massive bodies at the end of the massive ones.
+	//inSoftening is the body's softening length in m, which only matters if the force solver softens gravity.
+	void addBody(const std::string& inName, const double inMass, const vector3D_t& inPos, const vector3D_t& inVel, const double inSoftening = 0);
+	void addBody(const Planet& inPlanet, const double inSoftening);
+	//Remove a single body. Every body after it moves down one place.
+	void removeBody(std::size_t inIndex);
+	void reserve(std::size_t inSize);
+	std::size_t size() const;
+	bool empty() const;
+	//The number of massive bodies, which occupy indices [0, activeCount()), and of the massless test particles after them.
+	std::size_t activeCount() const;
+	std::size_t testParticleCount() const;
+	//Turn every massive body lighter than inMassFraction of the total mass into a test particle, so it no longer costs anything as a source.
+	//The order of the remaining massive bodies, and of the test particles, is kept. If inAbsorbMass is set, the mass taken away is added to the most massive body,
+	//so that the central body's pull on everything else still includes it. Returns the number of bodies reclassified.
+	std::size_t makeLightBodiesPassive(double inMassFraction, bool inAbsorbMass);
+
+	//Access to the raw arrays, for the kernels which do the heavy lifting.
+	BodyState& state();
+	const BodyState& state() const;
+	//The buffer for the state at the end of a step. Sized to match the current state, but its contents are left over from an earlier step.
+	BodyState& nextState();
+	//Make the next state the current one. The two buffers are swapped rather than copied, so this costs nothing however many bodies there are.
+	void advanceState();
+	AccelerationBuffer& accelerations();
+	const AccelerationBuffer& accelerations() const;
+	const alignedArray_t<double>& masses() const;
+	//The squared softening lengths, as the kernels use them, and a function to set the softening length of every body at once.
+	const alignedArray_t<double>& softening2() const;
+	void setSoftening(double inLength);
+	const std::vector<std::string>& names() const;
+
+	//Planet-like access to individual bodies.
+	PlanetView operator[](std::size_t inIndex);
+	ConstPlanetView operator[](std::size_t inIndex) const;
+
+	//The position of the centre of mass of the system, and a function to move the origin of the coordinate system to a new point.
+	vector3D_t centreOfMass() const;
+	void shiftOrigin(const vector3D_t& inNewOrigin);
+	//The velocity of the centre of mass, and a function to move into the frame where the centre of mass sits still at the origin.
+	//Total momentum is conserved, so once there the system stays there without needing to be moved back every step.
+	vector3D_t centreOfMassVelocity() const;
+	void moveToCentreOfMassFrame();
+
+	//Grant the views access to the individual mass and name entries.
+	friend class BasicPlanetView<BodySystem>;
+	friend class BasicPlanetView<const BodySystem>;
+};
+
+
+//View function definitions. These need to be visible to every user of the template, so they live in the header.
+template<typename SystemType>
+double BasicPlanetView<SystemType>::getMass() const {
+	return m_system->m_mass[m_index];
+}
+template<typename SystemType>
+dp::PhysicsVector<3> BasicPlanetView<SystemType>::getPosition() const {
+	const BodyState& state{ m_system->state() };
+	return { state.x[m_index], state.y[m_index], state.z[m_index] };
+}
+template<typename SystemType>
+dp::PhysicsVector<3> BasicPlanetView<SystemType>::getVelocity() const {
+	const BodyState& state{ m_system->state() };
+	return { state.vx[m_index], state.vy[m_index], state.vz[m_index] };
+}
+template<typename SystemType>
+dp::PhysicsVector<3> BasicPlanetView<SystemType>::getAcceleration() const {
+	const AccelerationBuffer& acc{ m_system->accelerations() };
+	return { acc.ax[m_index], acc.ay[m_index], acc.az[m_index] };
+}
+template<typename SystemType>
+const std::string& BasicPlanetView<SystemType>::getName() const {
+	return m_system->m_names[m_index];
+}
+
+template<typename SystemType>
+void BasicPlanetView<SystemType>::setMass(double inMass) const {
+	m_system->m_mass[m_index] = inMass;
+}
+template<typename SystemType>
+void BasicPlanetView<SystemType>::setPosition(const vector3D_t& inPos) const {
+	BodyState& state{ m_system->state() };
+	state.x[m_index] = inPos.x();
+	state.y[m_index] = inPos.y();
+	state.z[m_index] = inPos.z();
+}
+template<typename SystemType>
+void BasicPlanetView<SystemType>::setVelocity(const vector3D_t& inVel) const {
+	BodyState& state{ m_system->state() };
+	state.vx[m_index] = inVel.x();
+	state.vy[m_index] = inVel.y();
+	state.vz[m_index] = inVel.z();
+}
+template<typename SystemType>
+void BasicPlanetView<SystemType>::setAcceleration(const vector3D_t& inAcc) const {
+	AccelerationBuffer& acc{ m_system->accelerations() };
+	acc.ax[m_index] = inAcc.x();
+	acc.ay[m_index] = inAcc.y();
+	acc.az[m_index] = inAcc.z();
+}
+template<typename SystemType>
+void BasicPlanetView<SystemType>::setName(const std::string& inName) const {
+	m_system->m_names[m_index] = inName;
+}
+
+template<typename SystemType>
+Planet BasicPlanetView<SystemType>::toPlanet() const {
+	return Planet(getName(), getMass(), getPosition(), getVelocity(), getAcceleration());
+}
+
+
+#endif
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "BulirschStoer.h"
+
+namespace {
+
+//The number of substeps of each sequence, n_k = 2(k + 1).
+constexpr std::size_t substeps(std::size_t inSequence) {
+	return 2 * (inSequence + 1);
+}
+
+//The step size controller, after Hairer, Norsett and Wanner's ODEX. Growth is held to half as much again per step, as near the longest step for which
+//the extrapolation converges the error climbs far more steeply than its order suggests, and larger increases are mostly rejected.
+constexpr double safetyFactor{ 0.94 };
+constexpr double errorTarget{ 0.65 };
+constexpr double minimumFactor{ 0.1 };
+constexpr double maximumFactor{ 1.5 };
+
+constexpr std::size_t updateGrain{ 4096 };
+
+//The six coordinates of a body, by number, so that the extrapolation can treat them all alike.
+alignedArray_t<double>& coordinate(BodyState& inState, std::size_t inIndex) {
+	switch (inIndex) {
+	case 0:		return inState.x;
+	case 1:		return inState.y;
+	case 2:		return inState.z;
+	case 3:		return inState.vx;
+	case 4:		return inState.vy;
+	default:	return inState.vz;
+	}
+}
+
+}
+
+
+BulirschStoerIntegrator::BulirschStoerIntegrator(double inTolerance, ThreadPool& inPool) : Integrator{ inPool }, m_tolerance{ inTolerance } {}
+
+void BulirschStoerIntegrator::step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) {
+	if (!m_initialised) {
+		initialise(inBodies);
+		m_stepSize = inTimeStep;
+	}
+
+	//Take steps of the size the controller asks for until the next would reach the output time, then one to land on it.
+	double elapsed{ 0 };
+	bool finished{ false };
+	while (!finished) {
+		double stepSize{ m_stepSize };
+		finished = elapsed + stepSize >= inTimeStep;
+		if (finished) stepSize = inTimeStep - elapsed;
+		if (attemptStep(inBodies, inSolver, stepSize)) elapsed += stepSize;
+		else finished = false;
+		checkStepSize(m_stepSize, elapsed, inTimeStep);
+	}
+	++m_steps;
+}
+
+void BulirschStoerIntegrator::initialise(const BodySystem& inBodies) {
+	const std::size_t count{ inBodies.size() };
+	for (std::size_t k = 0; k < sequenceCount; ++k) {
+		m_sequences[k].previous.resize(count);
+		m_sequences[k].current.resize(count);
+		m_tableau[k].resize(count);
+	}
+	m_bodyError.assign(count, 0.0);
+
+	//The floors are a millionth of the typical distance from the origin and typical speed.
+	const BodyState& start{ inBodies.state() };
+	double sumR2{ 0 };
+	double sumV2{ 0 };
+	for (std::size_t i = 0; i < count; ++i) {
+		sumR2 += start.x[i] * start.x[i] + start.y[i] * start.y[i] + start.z[i] * start.z[i];
+		sumV2 += start.vx[i] * start.vx[i] + start.vy[i] * start.vy[i] + start.vz[i] * start.vz[i];
+	}
+	m_positionFloor = count > 0 ? 1e-6 * std::sqrt(sumR2 / static_cast<double>(count)) : 0;
+	m_velocityFloor = count > 0 ? 1e-6 * std::sqrt(sumV2 / static_cast<double>(count)) : 0;
+
+	m_haveStartAcc = false;
+	m_initialised = true;
+}
+
+bool BulirschStoerIntegrator::attemptStep(BodySystem& inBodies, const ForceSolver& inSolver, double inStepSize) {
+	const std::size_t count{ inBodies.size() };
+	BodyState& start{ inBodies.state() };
+	if (!m_haveStartAcc) {
+		computeAccelerations(inSolver, inBodies, start, m_startAcc);
+		m_haveStartAcc = true;
+	}
+
+	//The sequences run side by side, the longest claimed first so that the short ones fill in the gaps at the end. Each one's force calculations are
+	//made directly rather than through computeAccelerations, so that the count is not updated from several threads at once, and added up afterwards.
+	m_pool->run(sequenceCount, [&](std::size_t inTask) {
+		const std::size_t sequence{ sequenceCount - 1 - inTask };
+		modifiedMidpoint(inBodies, inSolver, inStepSize, sequence, substeps(sequence));
+	});
+	for (std::size_t k = 0; k < sequenceCount; ++k) m_forceEvaluations += substeps(k);
+
+	//Neville's scheme, extrapolating in place: after round j, m_tableau[k] holds the extrapolation of sequences k - j to k. The last correction
+	//made, between the best two extrapolations, is the error estimate.
+	m_pool->parallelFor(count, updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		double lastCorrection[6];
+		for (std::size_t i = inBegin; i < inEnd; ++i) {
+			for (std::size_t c = 0; c < 6; ++c) {
+				for (std::size_t j = 1; j < sequenceCount; ++j) {
+					for (std::size_t k = sequenceCount - 1; k >= j; --k) {
+						const double ratio{ static_cast<double>(substeps(k)) / static_cast<double>(substeps(k - j)) };
+						const double correction{ (coordinate(m_tableau[k], c)[i] - coordinate(m_tableau[k - 1], c)[i]) / (ratio * ratio - 1) };
+						coordinate(m_tableau[k], c)[i] += correction;
+						if (k == sequenceCount - 1) lastCorrection[c] = correction;
+					}
+				}
+			}
+
+			const BodyState& end{ m_tableau[sequenceCount - 1] };
+			const double startR{ std::sqrt(start.x[i] * start.x[i] + start.y[i] * start.y[i] + start.z[i] * start.z[i]) };
+			const double endR{ std::sqrt(end.x[i] * end.x[i] + end.y[i] * end.y[i] + end.z[i] * end.z[i]) };
+			const double startV{ std::sqrt(start.vx[i] * start.vx[i] + start.vy[i] * start.vy[i] + start.vz[i] * start.vz[i]) };
+			const double endV{ std::sqrt(end.vx[i] * end.vx[i] + end.vy[i] * end.vy[i] + end.vz[i] * end.vz[i]) };
+			const double positionScale{ m_tolerance * (std::max(startR, endR) + m_positionFloor) };
+			const double velocityScale{ m_tolerance * (std::max(startV, endV) + m_velocityFloor) };
+			const double positionError{ std::sqrt(lastCorrection[0] * lastCorrection[0] + lastCorrection[1] * lastCorrection[1] + lastCorrection[2] * lastCorrection[2]) / positionScale };
+			const double velocityError{ std::sqrt(lastCorrection[3] * lastCorrection[3] + lastCorrection[4] * lastCorrection[4] + lastCorrection[5] * lastCorrection[5]) / velocityScale };
+			m_bodyError[i] = std::max(positionError, velocityError);
+		}
+	});
+
+	double error{ 0 };
+	for (const double bodyError : m_bodyError) {
+		if (!(bodyError <= error)) error = bodyError;						//Lets a NaN through, so that the step is rejected.
+	}
+
+	//The extrapolated result is of order 2 sequenceCount, and its error estimate of order 2 sequenceCount - 1.
+	const double factor{ std::isfinite(error)
+		? std::clamp(safetyFactor * std::pow(errorTarget / error, 1.0 / (2 * sequenceCount - 1)), minimumFactor, maximumFactor)
+		: minimumFactor };
+	//At the long steps this method takes, the error often grows much faster than the asymptotic rate the factor assumes, so a failed step is at least halved.
+	if (!(error <= 1.0)) {
+		m_stepSize = inStepSize * std::min(factor, 0.5);
+		++m_rejectedSteps;
+		return false;
+	}
+	//A step cut short to land on an output time says little about how long the next can be, so it never shortens the step the controller had chosen.
+	const double nextStep{ factor * inStepSize };
+	m_stepSize = inStepSize < m_stepSize ? std::max(nextStep, m_stepSize) : nextStep;
+
+	std::swap(start, m_tableau[sequenceCount - 1]);
+	m_haveStartAcc = false;
+	++m_acceptedSteps;
+	return true;
+}
+
+//Gragg's modified midpoint method. With h = H/n and z_0 the starting state,
+//	z_1 = z_0 + h f(z_0),	z_(m+1) = z_(m-1) + 2h f(z_m),	and the result (z_n + z_(n-1) + h f(z_n)) / 2,
+//where f(z) is the velocity and acceleration of state z. The accelerations at the start are shared by every sequence.
+void BulirschStoerIntegrator::modifiedMidpoint(const BodySystem& inBodies, const ForceSolver& inSolver, double inStepSize, std::size_t inSequence, std::size_t inSubsteps) {
+	const std::size_t count{ inBodies.size() };
+	const double h{ inStepSize / static_cast<double>(inSubsteps) };
+	const BodyState& start{ inBodies.state() };
+	Sequence& sequence{ m_sequences[inSequence] };
+	BodyState* previous{ &sequence.previous };
+	BodyState* current{ &sequence.current };
+
+	*previous = start;
+	for (std::size_t i = 0; i < count; ++i) {
+		current->x[i] = start.x[i] + h * start.vx[i];
+		current->y[i] = start.y[i] + h * start.vy[i];
+		current->z[i] = start.z[i] + h * start.vz[i];
+		current->vx[i] = start.vx[i] + h * m_startAcc.ax[i];
+		current->vy[i] = start.vy[i] + h * m_startAcc.ay[i];
+		current->vz[i] = start.vz[i] + h * m_startAcc.az[i];
+	}
+
+	//Each new state overwrites the one two back, and the two are then swapped so that current is always the latest.
+	for (std::size_t m = 1; m < inSubsteps; ++m) {
+		inSolver.computeAccelerations(inBodies, *current, sequence.acc);
+		for (std::size_t i = 0; i < count; ++i) {
+			previous->x[i] += 2 * h * current->vx[i];
+			previous->y[i] += 2 * h * current->vy[i];
+			previous->z[i] += 2 * h * current->vz[i];
+			previous->vx[i] += 2 * h * sequence.acc.ax[i];
+			previous->vy[i] += 2 * h * sequence.acc.ay[i];
+			previous->vz[i] += 2 * h * sequence.acc.az[i];
+		}
+		std::swap(previous, current);
+	}
+
+	inSolver.computeAccelerations(inBodies, *current, sequence.acc);
+	BodyState& result{ m_tableau[inSequence] };
+	for (std::size_t i = 0; i < count; ++i) {
+		result.x[i] = 0.5 * (current->x[i] + previous->x[i] + h * current->vx[i]);
+		result.y[i] = 0.5 * (current->y[i] + previous->y[i] + h * current->vy[i]);
+		result.z[i] = 0.5 * (current->z[i] + previous->z[i] + h * current->vz[i]);
+		result.vx[i] = 0.5 * (current->vx[i] + previous->vx[i] + h * sequence.acc.ax[i]);
+		result.vy[i] = 0.5 * (current->vy[i] + previous->vy[i] + h * sequence.acc.ay[i]);
+		result.vz[i] = 0.5 * (current->vz[i] + previous->vz[i] + h * sequence.acc.az[i]);
+	}
+}
+
+void BulirschStoerIntegrator::reset() {
+	m_initialised = false;
+}
+std::string_view BulirschStoerIntegrator::name() const {
+	return "bulirschStoer";
+}
+void BulirschStoerIntegrator::printStatistics(std::ostream& outStream) const {
+	Integrator::printStatistics(outStream);
+	const std::size_t attempts{ m_acceptedSteps + m_rejectedSteps };
+	outStream << "Internal steps accepted: " << m_acceptedSteps << '\t' << "Rejected: " << m_rejectedSteps;
+	if (attempts > 0) outStream << " (" << 100.0 * static_cast<double>(m_rejectedSteps) / static_cast<double>(attempts) << "%)";
+	outStream << '\n';
+}
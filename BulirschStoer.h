@@ -0,0 +1,69 @@
+#ifndef BulirschStoer_H
+#define BulirschStoer_H
+
+#include <array>
+#include <cstddef>
+
+#include "Integrator.h"
+
+/*
+* The Bulirsch-Stoer extrapolation integrator, for smooth problems where very high accuracy is wanted from long steps.
+*
+* Each step of length H is crossed several times with Gragg's modified midpoint method, using n = 2, 4, 6, ..., 16 substeps. The modified midpoint error
+* is a series in even powers of the substep H/n only, so the results can be extrapolated to zero substep size (Richardson extrapolation, by Neville's
+* polynomial scheme in (H/n)^2). Eight sequences give a sixteenth order result, and the difference between the last two extrapolations estimates its error.
+* The step length is adjusted to keep that error just inside the tolerance, as for the Dormand-Prince integrator, and a step which misses it is retried.
+*
+* The eight sequences are independent of one another until the extrapolation, so they are run at the same time on the threads of the pool, longest first.
+* For small systems, where one force calculation is too little work to share between threads, this is the only way to keep more than one core busy.
+* Each sequence calls the force solver on its own thread, and the solver runs on that thread alone. The results are the same for any number of threads.
+*
+* Steps are chosen internally. Each call to step() takes as many as needed to reach the next output time, shortening the last one to land on it exactly.
+*
+* Reference: Hairer, E., Norsett, S. P. and Wanner, G. (1993). Solving Ordinary Differential Equations I, 2nd ed., section II.9.
+*/
+
+class BulirschStoerIntegrator : public Integrator
+{
+public:
+	static constexpr std::size_t sequenceCount{ 8 };
+
+private:
+	double							 m_tolerance{ 1e-10 };
+	bool							 m_initialised{ false };
+	bool							 m_haveStartAcc{ false };
+	double							 m_stepSize{ 0 };
+	double							 m_positionFloor{ 0 };			//Floors on the size of a body's position and velocity when scaling its error,
+	double							 m_velocityFloor{ 0 };			//as for the Dormand-Prince integrator.
+	AccelerationBuffer				 m_startAcc;
+
+	//The scratch space of one modified midpoint sequence, so that each can run on a thread of its own.
+	struct Sequence {
+		BodyState			 previous;
+		BodyState			 current;
+		AccelerationBuffer	 acc;
+	};
+	std::array<Sequence, sequenceCount>	 m_sequences;
+	std::array<BodyState, sequenceCount>	 m_tableau;				//The result of each sequence, extrapolated in place.
+	alignedArray_t<double>			 m_bodyError;
+
+	std::size_t						 m_acceptedSteps{ 0 };
+	std::size_t						 m_rejectedSteps{ 0 };
+
+	void initialise(const BodySystem& inBodies);
+	//Try one step of length inStepSize. Returns whether it was accepted. Either way, m_stepSize is left holding the next step to try.
+	bool attemptStep(BodySystem& inBodies, const ForceSolver& inSolver, double inStepSize);
+	//Cross the step with inSubsteps modified midpoint substeps, leaving the result in m_tableau[inSequence].
+	void modifiedMidpoint(const BodySystem& inBodies, const ForceSolver& inSolver, double inStepSize, std::size_t inSequence, std::size_t inSubsteps);
+
+public:
+	explicit BulirschStoerIntegrator(double inTolerance = 1e-10, ThreadPool& inPool = ThreadPool::serial());
+
+	void step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) override;
+	void reset() override;
+	std::string_view name() const override;
+	void printStatistics(std::ostream& outStream) const override;
+};
+
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef CompositionIntegrator_H
+#define CompositionIntegrator_H
+
+#include <array>
+#include <cstddef>
+
+#include "Integrator.h"
+
+/*
+* Higher order symplectic integrators built by composing leapfrog steps.
+*
+* A step of length dt is made up of a symmetric sequence of leapfrog steps of length w_1 dt, w_2 dt, ..., w_s dt with the w_i summing to one.
+* With the right choice of weights the leading error terms of the individual leapfrogs cancel, and the whole step is of order 4, 6 or 8 while staying symplectic and
+* time-reversible. Some of the weights are negative, so some substeps go backwards in time.
+*
+* Each leapfrog substep costs one force evaluation, since the accelerations at the end of one substep start the next, so an s-stage scheme costs s evaluations per step.
+* The schemes differ only in their weights. Each one is a small struct holding its name, order and weight table, and CompositionIntegrator is instantiated once per scheme.
+*
+* References for the weights:
+*	Yoshida, H. (1990). Construction of higher order symplectic integrators. Phys. Lett. A 150, 262.
+*	Suzuki, M. (1990). Fractal decomposition of exponential operators. Phys. Lett. A 146, 319.
+*	Kahan, W. and Li, R.-C. (1997). Composition constants for raising the orders of unconventional schemes for ordinary differential equations. Math. Comp. 66, 1089.
+*/
+
+namespace CompositionSchemes {
+
+	//The three-stage "triple jump". w = 1/(2 - 2^(1/3)) either side of a backward step of -2^(1/3)/(2 - 2^(1/3)).
+	struct Yoshida4 {
+		static constexpr const char* name{ "yoshida4" };
+		static constexpr std::size_t order{ 4 };
+		static constexpr std::array<double, 3> weights{
+			1.3512071919596578, -1.7024143839193153, 1.3512071919596578
+		};
+	};
+
+	//Suzuki's five-stage fourth order scheme. More stages than the triple jump, but a much smaller backward step and a smaller error constant.
+	struct Suzuki4 {
+		static constexpr const char* name{ "suzuki4" };
+		static constexpr std::size_t order{ 4 };
+		static constexpr std::array<double, 5> weights{
+			0.4144907717943757, 0.4144907717943757, -0.6579630871775028, 0.4144907717943757, 0.4144907717943757
+		};
+	};
+
+	//Yoshida's seven-stage sixth order scheme (his solution A).
+	struct Yoshida6 {
+		static constexpr const char* name{ "yoshida6" };
+		static constexpr std::size_t order{ 6 };
+		static constexpr std::array<double, 7> weights{
+			0.784513610477560, 0.235573213359357, -1.17767998417887, 1.3151863206839063,
+			-1.17767998417887, 0.235573213359357, 0.784513610477560
+		};
+	};
+
+	//Kahan and Li's nine-stage sixth order scheme (s9odr6a). Two more stages than Yoshida6, but a far smaller error for the same step.
+	struct KahanLi6 {
+		static constexpr const char* name{ "kahanLi6" };
+		static constexpr std::size_t order{ 6 };
+		static constexpr std::array<double, 9> weights{
+			0.3921614440073141, 0.3325991367893594, -0.7062461725576393, 0.0822135962935508, 0.7985439909348301,
+			0.0822135962935508, -0.7062461725576393, 0.3325991367893594, 0.3921614440073141
+		};
+	};
+
+	//Yoshida's fifteen-stage eighth order scheme (his solution D).
+	struct Yoshida8 {
+		static constexpr const char* name{ "yoshida8" };
+		static constexpr std::size_t order{ 8 };
+		static constexpr std::array<double, 15> weights{
+			0.914844246229740, 0.253693336566229, -1.44485223686048, -0.158240635368243, 1.93813913762276, -1.96061023297549, 0.102799849391985,
+			1.7084530707869978,
+			0.102799849391985, -1.96061023297549, 1.93813913762276, -0.158240635368243, -1.44485223686048, 0.253693336566229, 0.914844246229740
+		};
+	};
+
+	//Kahan and Li's fifteen-stage eighth order scheme (s15odr8). The same cost as Yoshida8 with a much smaller error constant.
+	struct KahanLi8 {
+		static constexpr const char* name{ "kahanLi8" };
+		static constexpr std::size_t order{ 8 };
+		static constexpr std::array<double, 15> weights{
+			0.74167036435061295, -0.40910082580003159, 0.19075471029623838, -0.57386247111608227, 0.29906418130365592, 0.33462491824529818, 0.31529309239676660,
+			-0.7968879393529165,
+			0.31529309239676660, 0.33462491824529818, 0.29906418130365592, -0.57386247111608227, 0.19075471029623838, -0.40910082580003159, 0.74167036435061295
+		};
+	};
+
+	//Checks on a weight table which can be made when the scheme is compiled: the weights must sum to one and read the same forwards and backwards.
+	template<std::size_t Stages>
+	constexpr bool weightsSumToOne(const std::array<double, Stages>& inWeights) {
+		double sum{ 0 };
+		for (std::size_t i = 0; i < Stages; ++i) sum += inWeights[i];
+		return sum - 1.0 < 1e-12 && 1.0 - sum < 1e-12;
+	}
+	template<std::size_t Stages>
+	constexpr bool weightsAreSymmetric(const std::array<double, Stages>& inWeights) {
+		for (std::size_t i = 0; i < Stages; ++i) {
+			if (inWeights[i] != inWeights[Stages - 1 - i]) return false;
+		}
+		return true;
+	}
+}
+
+
+template<typename Scheme>
+class CompositionIntegrator : public LeapfrogIntegrator
+{
+	static_assert(CompositionSchemes::weightsSumToOne(Scheme::weights), "The substeps of a composition scheme must add up to one whole step.");
+	static_assert(CompositionSchemes::weightsAreSymmetric(Scheme::weights), "A composition scheme must be symmetric to be time-reversible.");
+
+public:
+	explicit CompositionIntegrator(ThreadPool& inPool = ThreadPool::serial()) : LeapfrogIntegrator{ inPool } {}
+
+	void step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) override {
+		for (const double weight : Scheme::weights) kickDriftKick(inBodies, inSolver, weight * inTimeStep);
+		++m_steps;
+	}
+	std::string_view name() const override {
+		return Scheme::name;
+	}
+};
+
+using Yoshida4Integrator = CompositionIntegrator<CompositionSchemes::Yoshida4>;
+using Suzuki4Integrator = CompositionIntegrator<CompositionSchemes::Suzuki4>;
+using Yoshida6Integrator = CompositionIntegrator<CompositionSchemes::Yoshida6>;
+using KahanLi6Integrator = CompositionIntegrator<CompositionSchemes::KahanLi6>;
+using Yoshida8Integrator = CompositionIntegrator<CompositionSchemes::Yoshida8>;
+using KahanLi8Integrator = CompositionIntegrator<CompositionSchemes::KahanLi8>;
+
+
+#endif
@@ -0,0 +1,182 @@
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "Compression.h"
+
+namespace {
+	constexpr std::uint64_t signBit{ std::uint64_t{ 1 } << 63 };
+
+	//Map the bits of a double to an integer which sorts in the same order: negative numbers have all their bits flipped, so that larger magnitudes come
+	//first, and positive numbers are moved above them.
+	std::uint64_t toOrdered(double inValue) {
+		std::uint64_t bits;
+		std::memcpy(&bits, &inValue, sizeof(bits));
+		return bits & signBit ? ~bits : bits | signBit;
+	}
+	double fromOrdered(std::uint64_t inOrdered) {
+		const std::uint64_t bits{ inOrdered & signBit ? inOrdered & ~signBit : ~inOrdered };
+		double value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	//Interleave positive and negative differences, 0, -1, 1, -2, ..., so that both are small when near zero.
+	std::uint64_t zigzag(std::uint64_t inDifference) {
+		return (inDifference << 1) ^ (inDifference & signBit ? ~std::uint64_t{ 0 } : 0);
+	}
+	std::uint64_t unzigzag(std::uint64_t inZigzag) {
+		return (inZigzag >> 1) ^ (inZigzag & 1 ? ~std::uint64_t{ 0 } : 0);
+	}
+
+	//The number of bits needed to hold inValue, 0 for 0.
+	int bitWidth(std::uint64_t inValue) {
+		int width{ 0 };
+		for (int shift : { 32, 16, 8, 4, 2, 1 }) {
+			if (inValue >> shift) {
+				width += shift;
+				inValue >>= shift;
+			}
+		}
+		return width + static_cast<int>(inValue);
+	}
+}
+
+
+//Predictive codec
+void PredictiveCodec::reset(std::size_t inColumns) {
+	m_columns.assign(inColumns, Column{});
+}
+std::size_t PredictiveCodec::columns() const {
+	return m_columns.size();
+}
+
+//All arithmetic on the table wraps around, so a prediction far off, or a difference which overflows, still gets back to the exact value.
+std::uint64_t PredictiveCodec::predict(const Column& inColumn) {
+	std::uint64_t prediction{ 0 };
+	for (int i = 0; i < inColumn.order; ++i) prediction += inColumn.differences[i];
+	return prediction;
+}
+
+void PredictiveCodec::update(Column& outColumn, std::uint64_t inValue) {
+	//The prediction of each order adds one more difference to the one below it. The smallest zigzag coded difference is also the narrowest, and ties
+	//go to the lower order, which is the less sensitive to noise.
+	std::uint64_t prediction{ 0 };
+	std::uint64_t best{ zigzag(inValue) };
+	outColumn.order = 0;
+	for (int order = 1; order <= outColumn.available; ++order) {
+		prediction += outColumn.differences[order - 1];
+		const std::uint64_t difference{ zigzag(inValue - prediction) };
+		if (difference < best) {
+			best = difference;
+			outColumn.order = order;
+		}
+	}
+
+	std::uint64_t difference{ inValue };
+	for (int i = 0; i < maxOrder && i <= outColumn.available; ++i) {
+		const std::uint64_t previous{ outColumn.differences[i] };
+		outColumn.differences[i] = difference;
+		difference -= previous;
+	}
+	if (outColumn.available < maxOrder) ++outColumn.available;
+}
+
+
+//Compressor
+//Bits are packed from the lowest up. Whole bytes are moved to the block after every write, which leaves room in the 64 bit buffer for up to 56 more bits.
+void TrajectoryCompressor::writeBits(std::uint64_t inBits, int inWidth) {
+	if (inWidth > maxBitsAtOnce) {
+		writeBits(inBits, 32);
+		writeBits(inBits >> 32, inWidth - 32);
+		return;
+	}
+	m_bits |= (inBits & ((std::uint64_t{ 1 } << inWidth) - 1)) << m_bitCount;
+	m_bitCount += inWidth;
+	while (m_bitCount >= 8) {
+		m_block.push_back(static_cast<std::uint8_t>(m_bits));
+		m_bits >>= 8;
+		m_bitCount -= 8;
+	}
+}
+
+void TrajectoryCompressor::compress(const double* inValues) {
+	for (std::size_t i = 0; i < m_columns.size(); ++i) {
+		Column& column{ m_columns[i] };
+		const std::uint64_t value{ toOrdered(inValues[i]) };
+		const std::uint64_t difference{ zigzag(value - predict(column)) };
+		const int width{ bitWidth(difference) };
+		//Keep the column's width unless the difference does not fit, or would fit in so many fewer bits that writing the new width pays for itself.
+		if (width <= column.width && column.width - width <= widthBits) writeBits(0, 1);
+		else {
+			writeBits(1, 1);
+			writeBits(static_cast<std::uint64_t>(width), widthBits);
+			column.width = width;
+		}
+		writeBits(difference, column.width);
+		update(column, value);
+	}
+	++m_snapshots;
+}
+
+const std::vector<std::uint8_t>& TrajectoryCompressor::block() {
+	if (m_bitCount > 0) writeBits(0, 8 - m_bitCount);
+	return m_block;
+}
+std::size_t TrajectoryCompressor::snapshots() const {
+	return m_snapshots;
+}
+std::size_t TrajectoryCompressor::size() const {
+	return m_block.size();
+}
+void TrajectoryCompressor::clear() {
+	m_block.clear();
+	m_bits = 0;
+	m_bitCount = 0;
+	m_snapshots = 0;
+}
+
+
+//Decompressor
+void TrajectoryDecompressor::startBlock(const std::uint8_t* inData, std::size_t inSize) {
+	m_data = inData;
+	m_size = inSize;
+	m_position = 0;
+	m_bits = 0;
+	m_bitCount = 0;
+}
+
+std::uint64_t TrajectoryDecompressor::readBits(int inWidth) {
+	if (inWidth > maxBitsAtOnce) {
+		const std::uint64_t low{ readBits(32) };
+		return low | readBits(inWidth - 32) << 32;
+	}
+	while (m_bitCount < inWidth) {
+		if (m_position == m_size) {
+			std::cerr << "A compressed block of the trajectory ends in the middle of a snapshot.\n";
+			throw std::invalid_argument("Error: corrupt compressed trajectory");
+		}
+		m_bits |= static_cast<std::uint64_t>(m_data[m_position++]) << m_bitCount;
+		m_bitCount += 8;
+	}
+	const std::uint64_t bits{ m_bits & ((std::uint64_t{ 1 } << inWidth) - 1) };
+	m_bits >>= inWidth;
+	m_bitCount -= inWidth;
+	return bits;
+}
+
+void TrajectoryDecompressor::decompress(double* outValues) {
+	for (std::size_t i = 0; i < m_columns.size(); ++i) {
+		Column& column{ m_columns[i] };
+		if (readBits(1)) {
+			column.width = static_cast<int>(readBits(widthBits));
+			if (column.width > 64) {
+				std::cerr << "A compressed block of the trajectory has a difference " << column.width << " bits wide.\n";
+				throw std::invalid_argument("Error: corrupt compressed trajectory");
+			}
+		}
+		const std::uint64_t value{ predict(column) + unzigzag(readBits(column.width)) };
+		update(column, value);
+		outValues[i] = fromOrdered(value);
+	}
+}
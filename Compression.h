@@ -0,0 +1,98 @@
+#ifndef Compression_H
+#define Compression_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+* Lossless compression of the trajectory, for the compressed output format.
+*
+* A snapshot is a list of columns: the time, then every body's x, y and z. Each column changes smoothly from one snapshot to the next, so its next value
+* can be predicted by extrapolating a polynomial through the values before it, and only the difference between the prediction and the value is stored.
+* Along an orbit sampled every step, that difference is usually a few bits, where the value itself takes 64.
+*
+* The prediction is made on the bits of the doubles rather than on the doubles themselves. The bits are mapped to unsigned integers which sort in the same
+* order as the doubles, and which grow nearly linearly with them between powers of two. Integer arithmetic wraps around exactly, so the prediction, and
+* with it the file, is the same on every machine and with every compiler, and the difference gets back every bit of the value.
+*
+* Each column keeps its last maxOrder values as a table of backward differences, and the predictions of every order from 0 (no prediction) up to maxOrder
+* are running sums of that table. Whichever order would have done best for the column's previous value is used for its next one. A high order is best
+* while the samples are close together along smooth orbits, and a low one when they are far apart or a body's path bends sharply, as in a close encounter.
+*
+* The differences are zigzag coded, so that small negative numbers are small too, and written with only as many bits as they need. Each column keeps the
+* width of its last differences, and a single flag bit says a difference fits in it, so the width itself is only written when it changes by more than the
+* cost of writing it.
+*
+* The compressor and decompressor must be given the same columns in the same order, and both start again from nothing after reset().
+*/
+
+class PredictiveCodec
+{
+public:
+	static constexpr int maxOrder{ 7 };
+	static constexpr int widthBits{ 7 };				//Enough for any width from 0 to 64 bits.
+	static constexpr int maxBitsAtOnce{ 56 };			//The most bits the 64 bit buffers below take in one go, with up to 7 already waiting in them.
+
+protected:
+	struct Column {
+		std::uint64_t	 differences[maxOrder]{};		//The last value, then its backward differences of each order.
+		int				 available{ 0 };				//How many of those are known yet, from the values seen so far.
+		int				 order{ 0 };					//The order of prediction to use for the next value.
+		int				 width{ 64 };					//The width, in bits, of the differences being written.
+	};
+
+	std::vector<Column>	 m_columns;
+
+	//The value the column's chosen order predicts next.
+	static std::uint64_t predict(const Column& inColumn);
+	//Add the column's next value to its table, and choose the order for the one after from how well each order predicted this one.
+	static void update(Column& outColumn, std::uint64_t inValue);
+
+public:
+	//Start again with inColumns columns of no history.
+	void reset(std::size_t inColumns);
+	std::size_t columns() const;
+};
+
+
+class TrajectoryCompressor : public PredictiveCodec
+{
+	std::vector<std::uint8_t>	 m_block;
+	std::uint64_t				 m_bits{ 0 };			//Bits not yet whole bytes in m_block, from the lowest up.
+	int							 m_bitCount{ 0 };
+	std::size_t					 m_snapshots{ 0 };
+
+	void writeBits(std::uint64_t inBits, int inWidth);
+
+public:
+	//Add a snapshot, with one value for every column, to the current block.
+	void compress(const double* inValues);
+	//The current block, padded to a whole byte, and the number of snapshots in it. clear() then starts a new block, carrying on from the same history.
+	const std::vector<std::uint8_t>& block();
+	std::size_t snapshots() const;
+	//The size of the block so far, in whole bytes.
+	std::size_t size() const;
+	void clear();
+};
+
+
+class TrajectoryDecompressor : public PredictiveCodec
+{
+	const std::uint8_t*	 m_data{ nullptr };
+	std::size_t			 m_size{ 0 };
+	std::size_t			 m_position{ 0 };
+	std::uint64_t		 m_bits{ 0 };
+	int					 m_bitCount{ 0 };
+
+	std::uint64_t readBits(int inWidth);
+
+public:
+	//Read from a block made by the compressor. The block must outlive the calls to decompress.
+	void startBlock(const std::uint8_t* inData, std::size_t inSize);
+	//Read the next snapshot from the block, a value for every column. Throws if the block ends first, as it can only if the file is corrupt.
+	void decompress(double* outValues);
+};
+
+
+#endif
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "DormandPrince.h"
+
+namespace {
+
+//The Butcher tableau. Row s holds the weights of the earlier stages used to build stage s. The last row is also the fifth order solution itself.
+constexpr double stageWeights[7][6]{
+	{},
+	{ 1.0 / 5 },
+	{ 3.0 / 40, 9.0 / 40 },
+	{ 44.0 / 45, -56.0 / 15, 32.0 / 9 },
+	{ 19372.0 / 6561, -25360.0 / 2187, 64448.0 / 6561, -212.0 / 729 },
+	{ 9017.0 / 3168, -355.0 / 33, 46732.0 / 5247, 49.0 / 176, -5103.0 / 18656 },
+	{ 35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84 }
+};
+//The difference between the fifth and fourth order weights, which gives the error estimate.
+constexpr double errorWeights[7]{ 71.0 / 57600, 0, -71.0 / 16695, 71.0 / 1920, -17253.0 / 339200, 22.0 / 525, -1.0 / 40 };
+//The weights of the fifth order term of the dense output polynomial.
+constexpr double denseWeights[7]{ -12715105075.0 / 11282082432, 0, 87487479700.0 / 32700410799, -10690763975.0 / 1880347072,
+	701980252875.0 / 199316789632, -1453857185.0 / 822651844, 69997945.0 / 29380423 };
+
+//The step size controller. New steps are kept to between a fifth and ten times the last, with a safety factor to make the next step likely to be accepted.
+constexpr double safetyFactor{ 0.9 };
+constexpr double minimumFactor{ 0.2 };
+constexpr double maximumFactor{ 10.0 };
+constexpr double integralGain{ 0.04 };
+constexpr double proportionalExponent{ 0.2 - 0.75 * integralGain };
+
+constexpr std::size_t updateGrain{ 4096 };
+
+}
+
+
+DormandPrinceIntegrator::DormandPrinceIntegrator(double inTolerance, ThreadPool& inPool) : Integrator{ inPool }, m_tolerance{ inTolerance } {}
+
+void DormandPrinceIntegrator::step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) {
+	if (!m_initialised) initialise(inBodies, inSolver, inTimeStep);
+
+	//Keep stepping until the last accepted step reaches past the output time, then interpolate back to it.
+	const double target{ m_outputTime + inTimeStep };
+	while (m_time < target) {
+		attemptStep(inBodies, inSolver);
+		checkStepSize(m_stepSize, m_time, inTimeStep);
+	}
+
+	if (m_haveDense) evaluateDenseOutput(target, inBodies.state());
+	else inBodies.state() = m_stages[0];
+	m_outputTime = target;
+	++m_steps;
+}
+
+void DormandPrinceIntegrator::initialise(const BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) {
+	const std::size_t count{ inBodies.size() };
+	m_stages[0] = inBodies.state();
+	computeAccelerations(inSolver, inBodies, m_stages[0], m_stageAcc[0]);
+	m_bodyError.assign(count, 0.0);
+
+	//The floors are a millionth of the typical distance from the origin and typical speed.
+	const BodyState& start{ m_stages[0] };
+	double sumR2{ 0 };
+	double sumV2{ 0 };
+	for (std::size_t i = 0; i < count; ++i) {
+		sumR2 += start.x[i] * start.x[i] + start.y[i] * start.y[i] + start.z[i] * start.z[i];
+		sumV2 += start.vx[i] * start.vx[i] + start.vy[i] * start.vy[i] + start.vz[i] * start.vz[i];
+	}
+	m_positionFloor = count > 0 ? 1e-6 * std::sqrt(sumR2 / static_cast<double>(count)) : 0;
+	m_velocityFloor = count > 0 ? 1e-6 * std::sqrt(sumV2 / static_cast<double>(count)) : 0;
+
+	//The first step is a hundredth of the shortest timescale in the system, |r|/|v| or |v|/|a|. The controller lengthens it quickly if that turns out to be too cautious.
+	double shortestTime{ inTimeStep };
+	const AccelerationBuffer& acc{ m_stageAcc[0] };
+	for (std::size_t i = 0; i < count; ++i) {
+		const double r{ std::sqrt(start.x[i] * start.x[i] + start.y[i] * start.y[i] + start.z[i] * start.z[i]) + m_positionFloor };
+		const double v{ std::sqrt(start.vx[i] * start.vx[i] + start.vy[i] * start.vy[i] + start.vz[i] * start.vz[i]) + m_velocityFloor };
+		const double a{ std::sqrt(acc.ax[i] * acc.ax[i] + acc.ay[i] * acc.ay[i] + acc.az[i] * acc.az[i]) };
+		if (v > 0) shortestTime = std::min(shortestTime, r / v);
+		if (a > 0) shortestTime = std::min(shortestTime, v / a);
+	}
+	m_stepSize = 0.01 * shortestTime;
+
+	m_time = 0;
+	m_outputTime = 0;
+	m_previousError = 1e-4;
+	m_lastStepRejected = false;
+	m_haveDense = false;
+	m_initialised = true;
+}
+
+bool DormandPrinceIntegrator::attemptStep(const BodySystem& inBodies, const ForceSolver& inSolver) {
+	const std::size_t count{ inBodies.size() };
+	const double h{ m_stepSize };
+	const BodyState& start{ m_stages[0] };
+
+	//Stages 2 to 7. The derivative of a stage is its own velocity together with its acceleration.
+	for (std::size_t s = 1; s < stageCount; ++s) {
+		BodyState& stage{ m_stages[s] };
+		stage.resize(count);
+		m_pool->parallelFor(count, updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+			for (std::size_t i = inBegin; i < inEnd; ++i) {
+				double x{ start.x[i] };
+				double y{ start.y[i] };
+				double z{ start.z[i] };
+				double vx{ start.vx[i] };
+				double vy{ start.vy[i] };
+				double vz{ start.vz[i] };
+				for (std::size_t j = 0; j < s; ++j) {
+					const double weight{ h * stageWeights[s][j] };
+					x += weight * m_stages[j].vx[i];
+					y += weight * m_stages[j].vy[i];
+					z += weight * m_stages[j].vz[i];
+					vx += weight * m_stageAcc[j].ax[i];
+					vy += weight * m_stageAcc[j].ay[i];
+					vz += weight * m_stageAcc[j].az[i];
+				}
+				stage.x[i] = x;
+				stage.y[i] = y;
+				stage.z[i] = z;
+				stage.vx[i] = vx;
+				stage.vy[i] = vy;
+				stage.vz[i] = vz;
+			}
+		});
+		computeAccelerations(inSolver, inBodies, stage, m_stageAcc[s]);
+	}
+
+	const double error{ errorNorm(h) };
+	const double proportional{ std::pow(error, proportionalExponent) };
+
+	//Written this way round so that a NaN error is rejected too.
+	if (!(error <= 1.0)) {
+		m_stepSize = std::isfinite(error) ? h / std::min(1.0 / minimumFactor, proportional / safetyFactor) : h * minimumFactor;
+		m_lastStepRejected = true;
+		++m_rejectedSteps;
+		return false;
+	}
+
+	//The PI controller. The step grows when this error is small, and grows less if the previous one was large.
+	double factor{ proportional / std::pow(m_previousError, integralGain) / safetyFactor };
+	factor = std::clamp(factor, 1.0 / maximumFactor, 1.0 / minimumFactor);
+	double nextStep{ h / factor };
+	if (m_lastStepRejected) nextStep = std::min(nextStep, h);				//Straight after a rejection, don't try a longer step than the one which has just worked.
+	m_previousError = std::max(error, 1e-4);
+
+	storeDenseOutput(h);
+	m_denseStart = m_time;
+	m_haveDense = true;
+
+	//The last stage is the new state, and its accelerations are the first stage of the next step.
+	std::swap(m_stages[0], m_stages[stageCount - 1]);
+	std::swap(m_stageAcc[0], m_stageAcc[stageCount - 1]);
+	m_time += h;
+	m_stepSize = nextStep;
+	m_lastStepRejected = false;
+	++m_acceptedSteps;
+	return true;
+}
+
+//The largest error of any body, relative to the tolerance times the size of its position or velocity.
+double DormandPrinceIntegrator::errorNorm(double inStepSize) {
+	const BodyState& start{ m_stages[0] };
+	const BodyState& end{ m_stages[stageCount - 1] };
+	m_pool->parallelFor(m_bodyError.size(), updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		for (std::size_t i = inBegin; i < inEnd; ++i) {
+			double errorX{ 0 };
+			double errorY{ 0 };
+			double errorZ{ 0 };
+			double errorVX{ 0 };
+			double errorVY{ 0 };
+			double errorVZ{ 0 };
+			for (std::size_t j = 0; j < stageCount; ++j) {
+				const double weight{ inStepSize * errorWeights[j] };
+				errorX += weight * m_stages[j].vx[i];
+				errorY += weight * m_stages[j].vy[i];
+				errorZ += weight * m_stages[j].vz[i];
+				errorVX += weight * m_stageAcc[j].ax[i];
+				errorVY += weight * m_stageAcc[j].ay[i];
+				errorVZ += weight * m_stageAcc[j].az[i];
+			}
+			const double startR{ std::sqrt(start.x[i] * start.x[i] + start.y[i] * start.y[i] + start.z[i] * start.z[i]) };
+			const double endR{ std::sqrt(end.x[i] * end.x[i] + end.y[i] * end.y[i] + end.z[i] * end.z[i]) };
+			const double startV{ std::sqrt(start.vx[i] * start.vx[i] + start.vy[i] * start.vy[i] + start.vz[i] * start.vz[i]) };
+			const double endV{ std::sqrt(end.vx[i] * end.vx[i] + end.vy[i] * end.vy[i] + end.vz[i] * end.vz[i]) };
+			const double positionScale{ m_tolerance * (std::max(startR, endR) + m_positionFloor) };
+			const double velocityScale{ m_tolerance * (std::max(startV, endV) + m_velocityFloor) };
+			const double positionError{ std::sqrt(errorX * errorX + errorY * errorY + errorZ * errorZ) / positionScale };
+			const double velocityError{ std::sqrt(errorVX * errorVX + errorVY * errorVY + errorVZ * errorVZ) / velocityScale };
+			m_bodyError[i] = std::max(positionError, velocityError);
+		}
+	});
+
+	double largest{ 0 };
+	for (const double error : m_bodyError) {
+		if (!(error <= largest)) largest = error;						//Lets a NaN through, so that the step is rejected.
+	}
+	return largest;
+}
+
+//The coefficients of the interpolating polynomial over the step just taken, from Hairer, Norsett and Wanner's routine CONTD5:
+//	y(t0 + theta h) = d0 + theta (d1 + (1 - theta) (d2 + theta (d3 + (1 - theta) d4)))
+void DormandPrinceIntegrator::storeDenseOutput(double inStepSize) {
+	const BodyState& start{ m_stages[0] };
+	const BodyState& end{ m_stages[stageCount - 1] };
+	const AccelerationBuffer& startAcc{ m_stageAcc[0] };
+	const AccelerationBuffer& endAcc{ m_stageAcc[stageCount - 1] };
+	for (auto& coefficient : m_dense) coefficient.resize(start.size());
+
+	//One axis at a time, as the same arithmetic applies to each: p is a position component with derivative v, and v a velocity component with derivative a.
+	auto fillAxis = [&](std::size_t inBegin, std::size_t inEnd, alignedArray_t<double> BodyState::* inPos, alignedArray_t<double> BodyState::* inVel,
+		alignedArray_t<double> AccelerationBuffer::* inAcc) {
+		for (std::size_t i = inBegin; i < inEnd; ++i) {
+			double densePos{ 0 };
+			double denseVel{ 0 };
+			for (std::size_t j = 0; j < stageCount; ++j) {
+				densePos += denseWeights[j] * (m_stages[j].*inVel)[i];
+				denseVel += denseWeights[j] * (m_stageAcc[j].*inAcc)[i];
+			}
+
+			const double changePos{ (end.*inPos)[i] - (start.*inPos)[i] };
+			const double changeVel{ (end.*inVel)[i] - (start.*inVel)[i] };
+			const double secondPos{ inStepSize * (start.*inVel)[i] - changePos };
+			const double secondVel{ inStepSize * (startAcc.*inAcc)[i] - changeVel };
+
+			(m_dense[0].*inPos)[i] = (start.*inPos)[i];
+			(m_dense[1].*inPos)[i] = changePos;
+			(m_dense[2].*inPos)[i] = secondPos;
+			(m_dense[3].*inPos)[i] = changePos - inStepSize * (end.*inVel)[i] - secondPos;
+			(m_dense[4].*inPos)[i] = inStepSize * densePos;
+
+			(m_dense[0].*inVel)[i] = (start.*inVel)[i];
+			(m_dense[1].*inVel)[i] = changeVel;
+			(m_dense[2].*inVel)[i] = secondVel;
+			(m_dense[3].*inVel)[i] = changeVel - inStepSize * (endAcc.*inAcc)[i] - secondVel;
+			(m_dense[4].*inVel)[i] = inStepSize * denseVel;
+		}
+	};
+
+	m_pool->parallelFor(start.size(), updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		fillAxis(inBegin, inEnd, &BodyState::x, &BodyState::vx, &AccelerationBuffer::ax);
+		fillAxis(inBegin, inEnd, &BodyState::y, &BodyState::vy, &AccelerationBuffer::ay);
+		fillAxis(inBegin, inEnd, &BodyState::z, &BodyState::vz, &AccelerationBuffer::az);
+	});
+}
+
+void DormandPrinceIntegrator::evaluateDenseOutput(double inTime, BodyState& outState) const {
+	const double theta{ (inTime - m_denseStart) / (m_time - m_denseStart) };
+	const double oneMinusTheta{ 1.0 - theta };
+	outState.resize(m_dense[0].size());
+
+	auto evaluate = [&](alignedArray_t<double> BodyState::* inComponent, std::size_t inBegin, std::size_t inEnd) {
+		const double* d0{ (m_dense[0].*inComponent).data() };
+		const double* d1{ (m_dense[1].*inComponent).data() };
+		const double* d2{ (m_dense[2].*inComponent).data() };
+		const double* d3{ (m_dense[3].*inComponent).data() };
+		const double* d4{ (m_dense[4].*inComponent).data() };
+		double* out{ (outState.*inComponent).data() };
+		for (std::size_t i = inBegin; i < inEnd; ++i) {
+			out[i] = d0[i] + theta * (d1[i] + oneMinusTheta * (d2[i] + theta * (d3[i] + oneMinusTheta * d4[i])));
+		}
+	};
+
+	m_pool->parallelFor(outState.size(), updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		for (const auto component : { &BodyState::x, &BodyState::y, &BodyState::z, &BodyState::vx, &BodyState::vy, &BodyState::vz }) {
+			evaluate(component, inBegin, inEnd);
+		}
+	});
+}
+
+void DormandPrinceIntegrator::reset() {
+	m_initialised = false;
+	m_haveDense = false;
+}
+std::string_view DormandPrinceIntegrator::name() const {
+	return "dormandPrince";
+}
+void DormandPrinceIntegrator::printStatistics(std::ostream& outStream) const {
+	Integrator::printStatistics(outStream);
+	const std::size_t attempts{ m_acceptedSteps + m_rejectedSteps };
+	outStream << "Internal steps accepted: " << m_acceptedSteps << '\t' << "Rejected: " << m_rejectedSteps;
+	if (attempts > 0) outStream << " (" << 100.0 * static_cast<double>(m_rejectedSteps) / static_cast<double>(attempts) << "%)";
+	outStream << '\n';
+}
@@ -0,0 +1,76 @@
+#ifndef DormandPrince_H
+#define DormandPrince_H
+
+#include <array>
+#include <cstddef>
+
+#include "Integrator.h"
+
+/*
+* The Dormand-Prince 5(4) adaptive Runge-Kutta integrator.
+*
+* Each step takes seven stages and produces both a fifth and an embedded fourth order solution. The difference between the two estimates the error of the step,
+* and the step size is continually adjusted so that this error stays just inside the tolerance: short steps during close passes, long ones during quiet phases.
+* A step whose error is too large is rejected and retried with a shorter one.
+*
+* The step size is chosen by a proportional-integral (PI) controller, which looks at the error of the previous accepted step as well as the current one.
+* This stops the step size from oscillating between accepted and rejected steps, as a purely proportional controller is prone to.
+*
+* The last stage of each step is evaluated at the new state, so it doubles as the first stage of the next ("first same as last"), and an accepted step costs six
+* force evaluations rather than seven.
+*
+* The internal steps have no relation to the time step in config.txt, which now only sets how often output is wanted. The integrator carries its own state and time
+* from one call to the next, and each call to step() reports the state at exactly the next output time using the method's fifth order dense output. That interpolates
+* within whichever internal step covers that time, so the output cadence has no effect on the steps actually taken.
+*
+* The error of a step is measured body by body, relative to the size of each body's position and velocity, and the largest of these must be within the tolerance.
+* Taking the largest rather than an average means that a single small body in a close encounter, such as the Moon near Earth, still controls the step size.
+*
+* Reference: Hairer, E., Norsett, S. P. and Wanner, G. (1993). Solving Ordinary Differential Equations I, 2nd ed., sections II.4 to II.6.
+*/
+
+class DormandPrinceIntegrator : public Integrator
+{
+	static constexpr std::size_t stageCount{ 7 };
+
+	double							 m_tolerance{ 1e-10 };
+
+	//The state carried between calls. The first stage always holds the state at m_time, and its accelerations are those of that state.
+	bool							 m_initialised{ false };
+	double							 m_time{ 0 };
+	double							 m_outputTime{ 0 };				//The time of the state last reported to the BodySystem.
+	double							 m_stepSize{ 0 };
+	double							 m_previousError{ 1e-4 };		//The error of the last accepted step, for the integral term of the controller.
+	bool							 m_lastStepRejected{ false };
+	double							 m_positionFloor{ 0 };			//Floors on the size of a body's position and velocity when scaling its error,
+	double							 m_velocityFloor{ 0 };			//so a body sitting at the origin does not demand zero error.
+	std::array<BodyState, stageCount>			 m_stages;
+	std::array<AccelerationBuffer, stageCount>	 m_stageAcc;
+	alignedArray_t<double>			 m_bodyError;					//The scaled error of each body in the step being attempted.
+
+	//The dense output polynomial of the last accepted step, valid between m_denseStart and m_time.
+	bool							 m_haveDense{ false };
+	double							 m_denseStart{ 0 };
+	std::array<BodyState, 5>		 m_dense;
+
+	std::size_t						 m_acceptedSteps{ 0 };
+	std::size_t						 m_rejectedSteps{ 0 };
+
+	void initialise(const BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep);
+	//Try one step of length m_stepSize from m_time, and either accept it or shrink the step. Returns whether it was accepted.
+	bool attemptStep(const BodySystem& inBodies, const ForceSolver& inSolver);
+	double errorNorm(double inStepSize);
+	void storeDenseOutput(double inStepSize);
+	void evaluateDenseOutput(double inTime, BodyState& outState) const;
+
+public:
+	explicit DormandPrinceIntegrator(double inTolerance = 1e-10, ThreadPool& inPool = ThreadPool::serial());
+
+	void step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) override;
+	void reset() override;
+	std::string_view name() const override;
+	void printStatistics(std::ostream& outStream) const override;
+};
+
+
+#endif
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+
+#include "Encounters.h"
+
+namespace {
+	constexpr std::size_t hashGrain{ 4096 };
+	constexpr std::size_t searchBlock{ 1024 };			//Bodies per search task. Each task collects its encounters separately, and they are joined in task order.
+
+	//The 13 neighbouring cells which come after a cell in the sort order, those whose offset is lexicographically greater than (0, 0, 0).
+	constexpr std::array<std::array<std::int64_t, 3>, 13> forwardNeighbours{ {
+		{ 0, 0, 1 },
+		{ 0, 1, -1 }, { 0, 1, 0 }, { 0, 1, 1 },
+		{ 1, -1, -1 }, { 1, -1, 0 }, { 1, -1, 1 },
+		{ 1, 0, -1 }, { 1, 0, 0 }, { 1, 0, 1 },
+		{ 1, 1, -1 }, { 1, 1, 0 }, { 1, 1, 1 }
+	} };
+}
+
+
+EncounterDetector::EncounterDetector(double inRadius, ThreadPool& inPool) : m_radius{ inRadius }, m_pool{ &inPool } {}
+
+std::vector<Encounter>& EncounterDetector::findEncounters(const BodySystem& inBodies) {
+	return findEncounters(inBodies, inBodies.state());
+}
+std::vector<Encounter>& EncounterDetector::findEncounters(const BodySystem& inBodies, const BodyState& inState) {
+	const std::size_t count{ inBodies.size() };
+	const std::size_t activeCount{ inBodies.activeCount() };
+	const double cellsPerMetre{ 1.0 / m_radius };
+	const double radius2{ m_radius * m_radius };
+
+	//File every body under its cell, and sort them so that the bodies of each cell are next to each other.
+	m_keys.resize(count);
+	m_pool->parallelFor(count, hashGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		for (std::size_t i = inBegin; i < inEnd; ++i) {
+			m_keys[i] = { static_cast<std::int64_t>(std::floor(inState.x[i] * cellsPerMetre)),
+						  static_cast<std::int64_t>(std::floor(inState.y[i] * cellsPerMetre)),
+						  static_cast<std::int64_t>(std::floor(inState.z[i] * cellsPerMetre)) };
+		}
+	});
+	m_sorted.resize(count);
+	std::iota(m_sorted.begin(), m_sorted.end(), 0u);
+	std::sort(m_sorted.begin(), m_sorted.end(), [this](std::uint32_t a, std::uint32_t b) {
+		return m_keys[a] < m_keys[b] || (m_keys[a] == m_keys[b] && a < b);
+	});
+
+	//Then compare each body with the rest of its own cell and the bodies of its forward neighbours.
+	const std::size_t taskCount{ (count + searchBlock - 1) / searchBlock };
+	std::vector<std::vector<Encounter>> found(taskCount);
+	m_pool->run(taskCount, [&](std::size_t inTask) {
+		const std::size_t begin{ inTask * searchBlock };
+		const std::size_t end{ std::min(begin + searchBlock, count) };
+		std::vector<Encounter>& taskFound{ found[inTask] };
+
+		const auto check{ [&](std::uint32_t i, std::uint32_t j) {
+			if (i >= activeCount && j >= activeCount) return;						//Two test particles.
+			const double dx{ inState.x[j] - inState.x[i] };
+			const double dy{ inState.y[j] - inState.y[i] };
+			const double dz{ inState.z[j] - inState.z[i] };
+			const double r2{ dx * dx + dy * dy + dz * dz };
+			if (r2 < radius2) {
+				Encounter encounter;
+				encounter.first = std::min(i, j);
+				encounter.second = std::max(i, j);
+				encounter.distance = std::sqrt(r2);
+				taskFound.push_back(encounter);
+			}
+		} };
+
+		for (std::size_t p = begin; p < end; ++p) {
+			const std::uint32_t i{ m_sorted[p] };
+			const cellKey_t& key{ m_keys[i] };
+			for (std::size_t q = p + 1; q < count && m_keys[m_sorted[q]] == key; ++q) check(i, m_sorted[q]);
+
+			for (const auto& offset : forwardNeighbours) {
+				const cellKey_t neighbour{ key[0] + offset[0], key[1] + offset[1], key[2] + offset[2] };
+				auto q{ std::lower_bound(m_sorted.begin(), m_sorted.end(), neighbour, [this](std::uint32_t b, const cellKey_t& k) { return m_keys[b] < k; }) };
+				for (; q != m_sorted.end() && m_keys[*q] == neighbour; ++q) check(i, *q);
+			}
+		}
+	});
+
+	m_encounters.clear();
+	for (const auto& taskFound : found) m_encounters.insert(m_encounters.end(), taskFound.begin(), taskFound.end());
+	const auto byBodies{ [](const Encounter& a, const Encounter& b) { return a.first < b.first || (a.first == b.first && a.second < b.second); } };
+	std::sort(m_encounters.begin(), m_encounters.end(), byBodies);
+
+	//Both lists are sorted the same way, so the new encounters can be picked out in a single pass.
+	auto previous{ m_previous.begin() };
+	for (auto& encounter : m_encounters) {
+		while (previous != m_previous.end() && byBodies(*previous, encounter)) ++previous;
+		encounter.isNew = previous == m_previous.end() || byBodies(encounter, *previous);
+	}
+	m_previous = m_encounters;
+	return m_encounters;
+}
+
+void EncounterDetector::forgetEncounters() {
+	m_previous.clear();
+}
+double EncounterDetector::radius() const {
+	return m_radius;
+}
+void EncounterDetector::setRadius(double inRadius) {
+	m_radius = inRadius;
+}
+
+
+std::size_t mergeEncounters(BodySystem& inBodies, std::vector<Encounter>& inEncounters) {
+	BodyState& state{ inBodies.state() };
+	const alignedArray_t<double>& mass{ inBodies.masses() };
+
+	std::vector<std::size_t> byDistance(inEncounters.size());
+	std::iota(byDistance.begin(), byDistance.end(), std::size_t{ 0 });
+	std::stable_sort(byDistance.begin(), byDistance.end(), [&](std::size_t a, std::size_t b) { return inEncounters[a].distance < inEncounters[b].distance; });
+
+	std::vector<bool> involved(inBodies.size(), false);
+	std::vector<std::size_t> removed;
+	for (const std::size_t e : byDistance) {
+		Encounter& encounter{ inEncounters[e] };
+		if (involved[encounter.first] || involved[encounter.second]) continue;
+		involved[encounter.first] = true;
+		involved[encounter.second] = true;
+
+		const std::size_t survivor{ mass[encounter.second] > mass[encounter.first] ? encounter.second : encounter.first };
+		const std::size_t lost{ survivor == encounter.first ? encounter.second : encounter.first };
+		const double m1{ mass[survivor] };
+		const double m2{ mass[lost] };
+		const double total{ m1 + m2 };
+		//The survivor always has mass, as pairs of test particles are never reported, so the weights below are well defined.
+		const auto combine{ [&](alignedArray_t<double>& inArray) {
+			inArray[survivor] = (m1 * inArray[survivor] + m2 * inArray[lost]) / total;
+		} };
+		combine(state.x);
+		combine(state.y);
+		combine(state.z);
+		combine(state.vx);
+		combine(state.vy);
+		combine(state.vz);
+		inBodies[survivor].setMass(total);
+
+		encounter.merged = true;
+		removed.push_back(lost);
+	}
+
+	//Remove from the back so the indices still to be removed stay valid.
+	std::sort(removed.begin(), removed.end(), std::greater<>());
+	for (const std::size_t i : removed) inBodies.removeBody(i);
+	return removed.size();
+}
@@ -0,0 +1,66 @@
+#ifndef Encounters_H
+#define Encounters_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "BodySystem.h"
+#include "ThreadPool.h"
+
+/*
+* Close-encounter detection, for finding the pairs of bodies which come within a set distance (the encounter radius) of each other.
+*
+* Checking every pair would cost as much as a direct force calculation, so the detector uses a uniform spatial hash as a "broad phase".
+* Space is divided into cubic cells one encounter radius across, and every body is filed under the cell it sits in. Two bodies closer than the radius must then
+* be in the same cell or in neighbouring ones, so each body is only compared against the handful of bodies around it rather than against everything.
+* The bodies are sorted by cell, so finding the contents of a cell is a binary search, and the whole search costs O(N log N) however large the system.
+*
+* To visit each pair of cells only once, a body looks only at its own cell and the 13 neighbours which come after it in the sort order; the other 13 neighbours
+* look at it instead. Pairs of test particles are never reported, as they cannot affect each other.
+*
+* Each encounter is reported at every check while the pair stays within the radius, and marked as new the first time. Encounters are only looked for at the
+* times the detector is called, so two bodies which pass straight through each other between checks are missed.
+*/
+
+struct Encounter {
+	std::uint32_t	 first{ 0 };							//The two bodies, with first < second.
+	std::uint32_t	 second{ 0 };
+	double			 distance{ 0 };
+	bool			 isNew{ false };						//Whether the pair was not already in an encounter at the last check.
+	bool			 merged{ false };						//Set by mergeEncounters if the two bodies were merged.
+};
+
+class EncounterDetector
+{
+	using cellKey_t = std::array<std::int64_t, 3>;
+
+	double							 m_radius;
+	ThreadPool*						 m_pool;
+	std::vector<cellKey_t>			 m_keys;				//The cell of each body, in body order.
+	std::vector<std::uint32_t>		 m_sorted;				//Body indices sorted by cell.
+	std::vector<Encounter>			 m_encounters;
+	std::vector<Encounter>			 m_previous;			//The encounters found by the last check, for telling which ones are new.
+
+public:
+	explicit EncounterDetector(double inRadius, ThreadPool& inPool = ThreadPool::serial());
+
+	//Find every pair of bodies closer than the encounter radius at the current state of inBodies, sorted by first and then second body.
+	//The list is overwritten by the next call.
+	std::vector<Encounter>& findEncounters(const BodySystem& inBodies);
+	//The same, but with the positions taken from inState rather than from the bodies' own state.
+	std::vector<Encounter>& findEncounters(const BodySystem& inBodies, const BodyState& inState);
+	//Forget the encounters found so far, so that every encounter at the next check counts as new. Needed after the bodies have been renumbered, as by a merge.
+	void forgetEncounters();
+	double radius() const;
+	void setRadius(double inRadius);
+};
+
+//Merge the bodies of each encounter into one, conserving mass and momentum. The heavier body survives, at the centre of mass of the two and moving with it,
+//and the lighter one is removed from the system. Closer encounters are merged first, and a body already merged this call is not merged again until the next.
+//Returns the number of merges, and marks the merged encounters.
+std::size_t mergeEncounters(BodySystem& inBodies, std::vector<Encounter>& inEncounters);
+
+
+#endif
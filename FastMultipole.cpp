@@ -0,0 +1,391 @@
+#include <algorithm>
+#include <cmath>
+
+#include "FastMultipole.h"
+#include "Octree.h"
+
+/*
+* Notation used throughout, for a multi-index n = (nx, ny, nz) with |n| = nx + ny + nz and d^n = dx^nx dy^ny dz^nz:
+*
+*	Multipole moments of a cell about its centre of mass z_A:	Q_n = Sum( m_j (y_j - z_A)^n )
+*	Taylor coefficients of 1/r:									T_n(R) = (1/n!) d^n/dR^n (1/|R|)
+*	Local coefficients about a cell centre z_B:					psi(z_B + e) = Sum( l_k e^k ),	where psi(x) = Sum( m_j / |x - y_j| )
+*
+* with the translation operators
+*
+*	M2M:	Q_n(parent) += Sum over k <= n of  C(n,k) Q_k(child) s^(n-k),					s = z_child - z_parent
+*	M2L:	l_k(B)		+= Sum over n of (-1)^|n| C(n+k,n) Q_n(A) T_(n+k)(z_B - z_A),		|n| + |k| <= p
+*	L2L:	l_j(child)	+= Sum over k >= j of  C(k,j) l_k(parent) t^(k-j),				t = z_child - z_parent
+*
+* where C(n,k) is the product of the binomial coefficients of each component. The acceleration of a body is then G times the gradient of psi,
+* so a body at z_B + e feels G Sum( l_k k_i e^(k - e_i) ) along axis i.
+*/
+
+namespace {
+
+double binomial(std::size_t n, std::size_t k) {
+	double result{ 1 };
+	for (std::size_t i = 1; i <= k; ++i) result = result * static_cast<double>(n - k + i) / static_cast<double>(i);
+	return result;
+}
+
+}
+
+
+//Tables
+FastMultipoleSolver::Tables::Tables(std::size_t inOrder) : order{ inOrder } {
+	const std::size_t side{ order + 1 };
+	lookup.assign(side * side * side, 0xFFFF);
+
+	//Enumerate the multi-indices in order of increasing |n|, so that every lower index is always met before the ones built from it.
+	for (std::size_t m = 0; m <= order; ++m) {
+		for (std::size_t nx = m + 1; nx-- > 0;) {
+			for (std::size_t ny = m - nx + 1; ny-- > 0;) {
+				const std::size_t nz{ m - nx - ny };
+				lookup[(nx * side + ny) * side + nz] = static_cast<std::uint16_t>(exponents.size());
+				exponents.push_back({ static_cast<std::uint8_t>(nx), static_cast<std::uint8_t>(ny), static_cast<std::uint8_t>(nz) });
+			}
+		}
+	}
+	termCount = exponents.size();
+
+	lowerOne.resize(termCount);
+	lowerTwo.resize(termCount);
+	for (std::size_t t = 0; t < termCount; ++t) {
+		for (std::size_t axis = 0; axis < 3; ++axis) {
+			std::array<std::uint8_t, 3> lowered{ exponents[t] };
+			lowerOne[t][axis] = -1;
+			lowerTwo[t][axis] = -1;
+			if (lowered[axis] >= 1) {
+				--lowered[axis];
+				lowerOne[t][axis] = index(lowered[0], lowered[1], lowered[2]);
+			}
+			if (lowered[axis] >= 1) {
+				--lowered[axis];
+				lowerTwo[t][axis] = index(lowered[0], lowered[1], lowered[2]);
+			}
+		}
+	}
+
+	//The translation operators. Each is a sparse list of (out, in, shift, factor) products.
+	for (std::size_t n = 0; n < termCount; ++n) {
+		const auto& en{ exponents[n] };
+		for (std::size_t k = 0; k < termCount; ++k) {
+			const auto& ek{ exponents[k] };
+			const std::size_t orderN{ static_cast<std::size_t>(en[0]) + en[1] + en[2] };
+			const std::size_t orderK{ static_cast<std::size_t>(ek[0]) + ek[1] + ek[2] };
+
+			//M2M and L2L both pair an index with every index it dominates component by component.
+			if (ek[0] <= en[0] && ek[1] <= en[1] && ek[2] <= en[2]) {
+				const double factor{ binomial(en[0], ek[0]) * binomial(en[1], ek[1]) * binomial(en[2], ek[2]) };
+				const std::uint16_t difference{ index(en[0] - ek[0], en[1] - ek[1], en[2] - ek[2]) };
+				multipoleToMultipole.push_back({ static_cast<std::uint16_t>(n), static_cast<std::uint16_t>(k), difference, factor });
+				localToLocal.push_back({ static_cast<std::uint16_t>(k), static_cast<std::uint16_t>(n), difference, factor });
+			}
+
+			//M2L pairs every local index k with every multipole index n, up to a combined order of p.
+			if (orderN + orderK <= order) {
+				const double sign{ orderN % 2 == 0 ? 1.0 : -1.0 };
+				const double factor{ sign * binomial(en[0] + ek[0], en[0]) * binomial(en[1] + ek[1], en[1]) * binomial(en[2] + ek[2], en[2]) };
+				multipoleToLocal.push_back({ static_cast<std::uint16_t>(k), static_cast<std::uint16_t>(n), index(en[0] + ek[0], en[1] + ek[1], en[2] + ek[2]), factor });
+			}
+		}
+	}
+
+	//M2L is by far the most common operation, so its terms are grouped by output. This lets each local coefficient be summed in a register.
+	std::stable_sort(multipoleToLocal.begin(), multipoleToLocal.end(), [](const Term& a, const Term& b) { return a.out < b.out; });
+	multipoleToLocalStart.assign(termCount + 1, 0);
+	for (const auto& term : multipoleToLocal) ++multipoleToLocalStart[term.out + 1];
+	for (std::size_t t = 0; t < termCount; ++t) multipoleToLocalStart[t + 1] += multipoleToLocalStart[t];
+
+	firstOrderFactor.assign(termCount, 0.0);
+	secondOrderFactor.assign(termCount, 0.0);
+	for (std::size_t t = 1; t < termCount; ++t) {
+		const double m{ static_cast<double>(exponents[t][0] + exponents[t][1] + exponents[t][2]) };
+		firstOrderFactor[t] = (2 * m - 1) / m;
+		secondOrderFactor[t] = (m - 1) / m;
+	}
+}
+
+std::uint16_t FastMultipoleSolver::Tables::index(std::size_t nx, std::size_t ny, std::size_t nz) const {
+	const std::size_t side{ order + 1 };
+	return lookup[(nx * side + ny) * side + nz];
+}
+
+
+namespace {
+
+//Fill outMonomials with d^n for every multi-index in the tables.
+void computeMonomials(const FastMultipoleSolver::Tables& inTables, double dx, double dy, double dz, double* outMonomials) {
+	const double d[3]{ dx, dy, dz };
+	outMonomials[0] = 1;
+	for (std::size_t t = 1; t < inTables.termCount; ++t) {
+		for (std::size_t axis = 0; axis < 3; ++axis) {
+			if (inTables.lowerOne[t][axis] >= 0) {
+				outMonomials[t] = outMonomials[inTables.lowerOne[t][axis]] * d[axis];
+				break;
+			}
+		}
+	}
+}
+
+//Fill outDerivatives with the Taylor coefficients T_n(R) of 1/|R|, using the recurrence
+//	|n| r^2 T_n = -(2|n| - 1) Sum( R_i T_(n - e_i) ) - (|n| - 1) Sum( T_(n - 2e_i) ).
+void computeDerivatives(const FastMultipoleSolver::Tables& inTables, double rx, double ry, double rz, double* outDerivatives) {
+	const double r[3]{ rx, ry, rz };
+	const double r2{ rx * rx + ry * ry + rz * rz };
+	const double invR2{ 1.0 / r2 };
+	outDerivatives[0] = std::sqrt(invR2);
+	for (std::size_t t = 1; t < inTables.termCount; ++t) {
+		double firstOrder{ 0 };
+		double secondOrder{ 0 };
+		for (std::size_t axis = 0; axis < 3; ++axis) {
+			if (inTables.lowerOne[t][axis] >= 0) firstOrder += r[axis] * outDerivatives[inTables.lowerOne[t][axis]];
+			if (inTables.lowerTwo[t][axis] >= 0) secondOrder += outDerivatives[inTables.lowerTwo[t][axis]];
+		}
+		outDerivatives[t] = -(inTables.firstOrderFactor[t] * firstOrder + inTables.secondOrderFactor[t] * secondOrder) * invR2;
+	}
+}
+
+}
+
+
+//The expansions of every cell, and the tree-ordered partial sums of the accelerations from direct interactions.
+struct FastMultipoleSolver::Expansions {
+	std::vector<double>		 multipoles;
+	std::vector<double>		 locals;
+	alignedArray_t<double>	 sumX, sumY, sumZ;
+
+	double* multipole(std::size_t inNode, std::size_t inTerms) { return multipoles.data() + inNode * inTerms; }
+	double* local(std::size_t inNode, std::size_t inTerms) { return locals.data() + inNode * inTerms; }
+};
+
+
+namespace {
+
+//Cut the top off the tree, level by level, until at least inMinimumSubtrees cells are left below the cut (or there is nothing left to cut).
+//The cells above the cut are listed parents first in outUpper, and the roots of the subtrees below it in outSubtrees.
+void cutTree(const Octree& inTree, std::size_t inMinimumSubtrees, std::vector<std::uint32_t>& outUpper, std::vector<std::uint32_t>& outSubtrees) {
+	const std::vector<Octree::Node>& nodes{ inTree.nodes() };
+	outUpper.clear();
+	outSubtrees.assign(1, 0);
+	while (outSubtrees.size() < inMinimumSubtrees) {
+		std::vector<std::uint32_t> nextLevel;
+		bool anySplit{ false };
+		for (const std::uint32_t n : outSubtrees) {
+			const Octree::Node& node{ nodes[n] };
+			if (node.isLeaf()) {
+				nextLevel.push_back(n);
+				continue;
+			}
+			outUpper.push_back(n);
+			for (std::uint32_t c = node.firstChild; c < node.firstChild + node.childCount; ++c) nextLevel.push_back(c);
+			anySplit = true;
+		}
+		if (!anySplit) break;
+		outSubtrees = std::move(nextLevel);
+	}
+}
+
+}
+
+
+FastMultipoleSolver::FastMultipoleSolver(double inTheta, std::size_t inOrder, ThreadPool& inPool) : ForceSolver{ inPool }, m_theta{ inTheta }, m_tables{ inOrder } {}
+
+void FastMultipoleSolver::computeAccelerations(const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc) const {
+	const std::size_t count{ inState.size() };
+	outAcc.resize(count);
+	if (count == 0) return;
+
+	//Much larger leaves than Barnes-Hut. Every cell-cell interaction costs hundreds of operations, while the direct sums within a leaf are cheap by comparison,
+	//and measured on 200,000 bodies leaves of 64 were roughly twice as fast as leaves of 16 for the same accuracy.
+	const Octree tree{ inBodies, inState, count, 64 };
+	const std::size_t terms{ m_tables.termCount };
+
+	Expansions expansions;
+	expansions.multipoles.assign(tree.nodes().size() * terms, 0.0);
+	expansions.locals.assign(tree.nodes().size() * terms, 0.0);
+	expansions.sumX.assign(count, 0.0);
+	expansions.sumY.assign(count, 0.0);
+	expansions.sumZ.assign(count, 0.0);
+
+	std::vector<std::uint32_t> upper;
+	std::vector<std::uint32_t> subtrees;
+	cutTree(tree, 256, upper, subtrees);
+	std::vector<double> scratch(terms);
+
+	//Upward pass, then the cell-cell interactions, then the downward pass. Each is a barrier, as every pass needs the whole of the one before.
+	m_pool->run(subtrees.size(), [&](std::size_t inSubtree) {
+		std::vector<double> taskScratch(terms);
+		buildMultipoles(tree, expansions, subtrees[inSubtree], taskScratch.data());
+	});
+	for (auto n = upper.rbegin(); n != upper.rend(); ++n) shiftMultipolesUp(tree, expansions, *n, scratch.data());
+
+	m_pool->run(subtrees.size(), [&](std::size_t inSubtree) {
+		std::vector<double> taskScratch(terms);
+		interact(tree, expansions, subtrees[inSubtree], 0, taskScratch.data());
+	});
+
+	for (const std::uint32_t n : upper) shiftLocalsDown(tree, expansions, n, scratch.data());
+	m_pool->run(subtrees.size(), [&](std::size_t inSubtree) {
+		std::vector<double> taskScratch(terms);
+		evaluateLocals(tree, expansions, subtrees[inSubtree], outAcc, taskScratch.data());
+	});
+}
+
+//Upward pass. The moments of a leaf come from its bodies, and those of every other cell are shifted up from its children.
+void FastMultipoleSolver::buildMultipoles(const Octree& inTree, Expansions& inExpansions, std::uint32_t inNode, double* inScratch) const {
+	const std::size_t terms{ m_tables.termCount };
+	const Octree::Node& node{ inTree.nodes()[inNode] };
+
+	if (node.isLeaf()) {
+		double* moments{ inExpansions.multipole(inNode, terms) };
+		double* monomials{ inScratch };
+		for (std::uint32_t j = node.bodyBegin; j < node.bodyEnd; ++j) {
+			computeMonomials(m_tables, inTree.x()[j] - node.comX, inTree.y()[j] - node.comY, inTree.z()[j] - node.comZ, monomials);
+			const double mass{ inTree.masses()[j] };
+			for (std::size_t t = 0; t < terms; ++t) moments[t] += mass * monomials[t];
+		}
+		return;
+	}
+
+	for (std::uint32_t c = node.firstChild; c < node.firstChild + node.childCount; ++c) buildMultipoles(inTree, inExpansions, c, inScratch);
+	shiftMultipolesUp(inTree, inExpansions, inNode, inScratch);
+}
+
+//Add the moments of each of a cell's children, shifted to the cell's own centre of mass, to its own. The children must already be complete.
+void FastMultipoleSolver::shiftMultipolesUp(const Octree& inTree, Expansions& inExpansions, std::uint32_t inNode, double* inScratch) const {
+	const std::size_t terms{ m_tables.termCount };
+	const Octree::Node& node{ inTree.nodes()[inNode] };
+	double* moments{ inExpansions.multipole(inNode, terms) };
+	double* monomials{ inScratch };
+	for (std::uint32_t c = node.firstChild; c < node.firstChild + node.childCount; ++c) {
+		const Octree::Node& child{ inTree.nodes()[c] };
+		const double* childMoments{ inExpansions.multipole(c, terms) };
+		computeMonomials(m_tables, child.comX - node.comX, child.comY - node.comY, child.comZ - node.comZ, monomials);
+		for (const auto& term : m_tables.multipoleToMultipole) {
+			moments[term.out] += term.factor * childMoments[term.in] * monomials[term.shift];
+		}
+	}
+}
+
+//The dual tree walk. Works out how the bodies of inSource act on the bodies of inTarget.
+void FastMultipoleSolver::interact(const Octree& inTree, Expansions& inExpansions, std::uint32_t inTarget, std::uint32_t inSource, double* inScratch) const {
+	const std::vector<Octree::Node>& nodes{ inTree.nodes() };
+	const Octree::Node& target{ nodes[inTarget] };
+	const Octree::Node& source{ nodes[inSource] };
+	if (source.mass <= 0) return;												//Nothing to feel.
+
+	if (inTarget != inSource) {
+		const double rx{ target.comX - source.comX };
+		const double ry{ target.comY - source.comY };
+		const double rz{ target.comZ - source.comZ };
+		const double r2{ rx * rx + ry * ry + rz * rz };
+		const double radii{ target.radius + source.radius };
+		if (radii * radii < m_theta * m_theta * r2) {
+			//Well separated, so the source's multipole expansion is converted into a contribution to the target's local expansion.
+			const std::size_t termCount{ m_tables.termCount };
+			double* derivatives{ inScratch };
+			computeDerivatives(m_tables, rx, ry, rz, derivatives);
+			const double* moments{ inExpansions.multipole(inSource, termCount) };
+			double* local{ inExpansions.local(inTarget, termCount) };
+			const FastMultipoleSolver::Tables::Term* terms{ m_tables.multipoleToLocal.data() };
+			for (std::size_t k = 0; k < m_tables.termCount; ++k) {
+				double sum{ 0 };
+				for (std::uint32_t t = m_tables.multipoleToLocalStart[k]; t < m_tables.multipoleToLocalStart[k + 1]; ++t) {
+					sum += terms[t].factor * moments[terms[t].in] * derivatives[terms[t].shift];
+				}
+				local[k] += sum;
+			}
+			return;
+		}
+	}
+
+	if (target.isLeaf() && source.isLeaf()) {
+		//Two leaves too close for their expansions to be trusted are summed directly.
+		const double* x{ inTree.x().data() };
+		const double* y{ inTree.y().data() };
+		const double* z{ inTree.z().data() };
+		const double* mass{ inTree.masses().data() };
+		for (std::uint32_t i = target.bodyBegin; i < target.bodyEnd; ++i) {
+			double sumX{ 0 };
+			double sumY{ 0 };
+			double sumZ{ 0 };
+			for (std::uint32_t j = source.bodyBegin; j < source.bodyEnd; ++j) {
+				const double dx{ x[j] - x[i] };
+				const double dy{ y[j] - y[i] };
+				const double dz{ z[j] - z[i] };
+				const double r2{ dx * dx + dy * dy + dz * dz };
+				if (r2 <= 0) continue;												//Skip a body paired with itself.
+				const double invR{ 1.0 / std::sqrt(r2) };
+				const double factor{ mass[j] * invR * invR * invR };
+				sumX += factor * dx;
+				sumY += factor * dy;
+				sumZ += factor * dz;
+			}
+			inExpansions.sumX[i] += sumX;
+			inExpansions.sumY[i] += sumY;
+			inExpansions.sumZ[i] += sumZ;
+		}
+		return;
+	}
+
+	//Otherwise split whichever cell is larger, and try again with its children.
+	const bool splitTarget{ source.isLeaf() || (!target.isLeaf() && target.radius >= source.radius) };
+	if (splitTarget) {
+		for (std::uint32_t c = target.firstChild; c < target.firstChild + target.childCount; ++c) interact(inTree, inExpansions, c, inSource, inScratch);
+	}
+	else {
+		for (std::uint32_t c = source.firstChild; c < source.firstChild + source.childCount; ++c) interact(inTree, inExpansions, inTarget, c, inScratch);
+	}
+}
+
+//Add the local expansion of a cell, shifted to the centre of each of its children, to theirs.
+void FastMultipoleSolver::shiftLocalsDown(const Octree& inTree, Expansions& inExpansions, std::uint32_t inNode, double* inScratch) const {
+	const std::size_t terms{ m_tables.termCount };
+	const Octree::Node& node{ inTree.nodes()[inNode] };
+	const double* local{ inExpansions.local(inNode, terms) };
+	double* monomials{ inScratch };
+	for (std::uint32_t c = node.firstChild; c < node.firstChild + node.childCount; ++c) {
+		const Octree::Node& child{ inTree.nodes()[c] };
+		double* childLocal{ inExpansions.local(c, terms) };
+		computeMonomials(m_tables, child.comX - node.comX, child.comY - node.comY, child.comZ - node.comZ, monomials);
+		for (const auto& term : m_tables.localToLocal) {
+			childLocal[term.out] += term.factor * local[term.in] * monomials[term.shift];
+		}
+	}
+}
+
+//Downward pass. Local expansions are shifted down to the leaves, where they are evaluated at each body and added to the direct sums.
+void FastMultipoleSolver::evaluateLocals(const Octree& inTree, Expansions& inExpansions, std::uint32_t inNode, AccelerationBuffer& outAcc, double* inScratch) const {
+	constexpr double G{ BodySystem::G };
+	const std::size_t terms{ m_tables.termCount };
+	const Octree::Node& node{ inTree.nodes()[inNode] };
+
+	if (!node.isLeaf()) {
+		shiftLocalsDown(inTree, inExpansions, inNode, inScratch);
+		for (std::uint32_t c = node.firstChild; c < node.firstChild + node.childCount; ++c) evaluateLocals(inTree, inExpansions, c, outAcc, inScratch);
+		return;
+	}
+
+	const double* local{ inExpansions.local(inNode, terms) };
+	double* monomials{ inScratch };
+	for (std::uint32_t i = node.bodyBegin; i < node.bodyEnd; ++i) {
+		computeMonomials(m_tables, inTree.x()[i] - node.comX, inTree.y()[i] - node.comY, inTree.z()[i] - node.comZ, monomials);
+		double gradient[3]{ inExpansions.sumX[i], inExpansions.sumY[i], inExpansions.sumZ[i] };
+		for (std::size_t t = 1; t < terms; ++t) {
+			for (std::size_t axis = 0; axis < 3; ++axis) {
+				const std::int32_t lower{ m_tables.lowerOne[t][axis] };
+				if (lower >= 0) gradient[axis] += local[t] * m_tables.exponents[t][axis] * monomials[lower];
+			}
+		}
+		const std::uint32_t original{ inTree.order()[i] };
+		outAcc.ax[original] = G * gradient[0];
+		outAcc.ay[original] = G * gradient[1];
+		outAcc.az[original] = G * gradient[2];
+	}
+}
+
+std::string_view FastMultipoleSolver::name() const {
+	return "fmm";
+}
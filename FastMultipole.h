@@ -0,0 +1,87 @@
+#ifndef FastMultipole_H
+#define FastMultipole_H
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "ForceSolver.h"
+
+class Octree;
+
+/*
+* The Fast Multipole Method solver, using Cartesian Taylor expansions of configurable order p.
+*
+* Where Barnes-Hut lets each body interact with distant cells one at a time, the FMM lets whole cells interact with whole cells.
+* Each cell's contents are summarised by a multipole expansion about its centre of mass, and the field it produces inside a distant cell is
+* converted into a local (Taylor) expansion about that cell's centre. Local expansions are then passed down the tree and finally evaluated at each body.
+* Because the cell-cell interactions no longer scale with the number of bodies in the target, the total cost is O(N) rather than O(N log N).
+*
+* Cell pairs are found by a dual tree walk starting from (root, root). A pair of cells with radii r_A and r_B whose centres are a distance d apart interacts
+* through their expansions if r_A + r_B < theta * d; otherwise the larger of the two is split, and two leaves which are too close are summed directly.
+*
+* The expansions are truncated at total order p (set by expansionOrder in config.txt). Higher orders are more accurate, with the force error falling roughly as theta^p,
+* but the number of terms grows as (p+1)(p+2)(p+3)/6 and the cost of a cell-cell interaction as the square of that.
+*
+* To share the work between threads, the top few levels of the tree are cut off to leave a few hundred independent subtrees. Each pass works on those subtrees in parallel,
+* and the cells above them are handled on one thread. The dual walk is started from every subtree paired with the root, so every cell written to belongs to exactly one task.
+* The cut does not depend on the number of threads, so neither do the results.
+*
+* Test particles have to stay in the tree, as the local expansions are only evaluated at bodies inside it. Having no mass, they add nothing to the multipoles,
+* but they do make the tree bigger, so barnesHut or direct is usually the better choice for a large swarm of them around a few massive bodies.
+*/
+
+class FastMultipoleSolver : public ForceSolver
+{
+public:
+	static constexpr std::size_t maxOrder{ 10 };
+
+	//Precomputed index tables for the multi-indices n = (nx, ny, nz) with nx + ny + nz <= p, and the coefficient lists of the translation operators.
+	struct Tables {
+		struct Term {
+			std::uint16_t	 out;				//The coefficient being accumulated into.
+			std::uint16_t	 in;				//The coefficient being read.
+			std::uint16_t	 shift;				//The index of the derivative or monomial it is multiplied by.
+			double			 factor;			//And the constant prefactor.
+		};
+
+		std::size_t									 order{ 0 };
+		std::size_t									 termCount{ 0 };
+		std::vector<std::array<std::uint8_t, 3>>	 exponents;					//Multi-index of each term, ordered by total order.
+		std::vector<std::uint16_t>					 lookup;					//(nx, ny, nz) -> term, stored as a (p+1)^3 cube.
+		std::vector<std::array<std::int32_t, 3>>	 lowerOne;					//The term n - e_i for each axis, or -1 if n_i is zero.
+		std::vector<std::array<std::int32_t, 3>>	 lowerTwo;					//The term n - 2e_i for each axis, or -1 if n_i < 2.
+		std::vector<Term>							 multipoleToMultipole;
+		std::vector<Term>							 multipoleToLocal;			//Sorted by output term, so each local coefficient is one contiguous run.
+		std::vector<std::uint32_t>					 multipoleToLocalStart;		//Where each output term's run begins, plus one past the end.
+		std::vector<double>							 firstOrderFactor;			//(2|n| - 1)/|n| and (|n| - 1)/|n|, for the derivative recurrence.
+		std::vector<double>							 secondOrderFactor;
+		std::vector<Term>							 localToLocal;
+
+		explicit Tables(std::size_t inOrder);
+		std::uint16_t index(std::size_t nx, std::size_t ny, std::size_t nz) const;
+	};
+
+private:
+	double		 m_theta{ 0.5 };
+	Tables		 m_tables;
+
+	//The per-call working data. Kept out of the class so that one solver can be used by several threads at once.
+	//Each thread also brings its own scratch space, big enough for one set of monomials or derivatives.
+	struct Expansions;
+	void buildMultipoles(const Octree& inTree, Expansions& inExpansions, std::uint32_t inNode, double* inScratch) const;
+	void shiftMultipolesUp(const Octree& inTree, Expansions& inExpansions, std::uint32_t inNode, double* inScratch) const;
+	void interact(const Octree& inTree, Expansions& inExpansions, std::uint32_t inTarget, std::uint32_t inSource, double* inScratch) const;
+	void shiftLocalsDown(const Octree& inTree, Expansions& inExpansions, std::uint32_t inNode, double* inScratch) const;
+	void evaluateLocals(const Octree& inTree, Expansions& inExpansions, std::uint32_t inNode, AccelerationBuffer& outAcc, double* inScratch) const;
+
+public:
+	explicit FastMultipoleSolver(double inTheta = 0.5, std::size_t inOrder = 4, ThreadPool& inPool = ThreadPool::serial());
+
+	void computeAccelerations(const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc) const override;
+	std::string_view name() const override;
+};
+
+
+#endif
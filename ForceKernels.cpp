@@ -0,0 +1,154 @@
+//The scalar kernel is the reference the vector variants must match, so it is kept free of fused multiply-adds too, even in builds for processors with FMA.
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+#include <array>
+
+#include "ForceKernels.h"
+#include "ForceKernelsImpl.h"
+
+//The x86 variants only exist on x86 builds. Elsewhere we always use the scalar kernel.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FORCE_KERNELS_X86
+#if defined(_MSC_VER)
+#include <intrin.h>					//For __cpuidex and _xgetbv
+#else
+#include <cpuid.h>					//For __cpuid_count
+#endif
+
+//Defined in the ForceKernels_<ISA>.cpp files, each of which is compiled with its own instruction set flags. Each returns that file's kernel for the given softening.
+directKernel_t directAccelerationsSSE2(Softening inSoftening);
+directKernel_t directAccelerationsAVX2(Softening inSoftening);
+directKernel_t directAccelerationsAVX512(Softening inSoftening);
+jerkKernel_t directAccelerationsAndJerksSSE2(Softening inSoftening);
+jerkKernel_t directAccelerationsAndJerksAVX2(Softening inSoftening);
+jerkKernel_t directAccelerationsAndJerksAVX512(Softening inSoftening);
+#endif
+
+
+namespace {
+
+directKernel_t directAccelerationsScalar(Softening inSoftening) {
+	return directKernelFor<ScalarOps>(inSoftening);
+}
+jerkKernel_t directAccelerationsAndJerksScalar(Softening inSoftening) {
+	return jerkKernelFor<ScalarOps>(inSoftening);
+}
+
+#ifdef FORCE_KERNELS_X86
+//Returns EAX, EBX, ECX, EDX for the given CPUID leaf and subleaf.
+struct CpuidResult {
+	unsigned int eax{ 0 }, ebx{ 0 }, ecx{ 0 }, edx{ 0 };
+};
+CpuidResult cpuid(unsigned int inLeaf, unsigned int inSubleaf) {
+	CpuidResult result;
+#if defined(_MSC_VER)
+	int registers[4];
+	__cpuidex(registers, static_cast<int>(inLeaf), static_cast<int>(inSubleaf));
+	result = { static_cast<unsigned int>(registers[0]), static_cast<unsigned int>(registers[1]), static_cast<unsigned int>(registers[2]), static_cast<unsigned int>(registers[3]) };
+#else
+	__cpuid_count(inLeaf, inSubleaf, result.eax, result.ebx, result.ecx, result.edx);
+#endif
+	return result;
+}
+
+//The XCR0 register tells us which register states the operating system saves on a context switch.
+//A processor supporting AVX is no use to us if the OS would trash the upper halves of the registers.
+unsigned long long readXCR0() {
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+}
+
+
+InstructionSet detectInstructionSet() {
+#ifdef FORCE_KERNELS_X86
+	const unsigned int maxLeaf{ cpuid(0, 0).eax };
+	const CpuidResult leaf1{ cpuid(1, 0) };
+
+	const bool hasSSE2{ (leaf1.edx & (1u << 26)) != 0 };
+	if (!hasSSE2) return InstructionSet::scalar;
+
+	//AVX needs both the OSXSAVE bit (27) and AVX bit (28) of leaf 1, and the OS must save the SSE and AVX register states (XCR0 bits 1 and 2).
+	const bool osSavesYmm{ (leaf1.ecx & (1u << 27)) != 0 && (leaf1.ecx & (1u << 28)) != 0 && (readXCR0() & 0x6) == 0x6 };
+	if (!osSavesYmm || maxLeaf < 7) return InstructionSet::sse2;
+
+	const CpuidResult leaf7{ cpuid(7, 0) };
+	//AVX-512 additionally needs the opmask and both halves of the ZMM state saved (XCR0 bits 5, 6 and 7).
+	const bool hasAVX512F{ (leaf7.ebx & (1u << 16)) != 0 && (readXCR0() & 0xE6) == 0xE6 };
+	const bool hasAVX2{ (leaf7.ebx & (1u << 5)) != 0 };
+
+	if (hasAVX512F) return InstructionSet::avx512;
+	if (hasAVX2) return InstructionSet::avx2;
+	return InstructionSet::sse2;
+#else
+	return InstructionSet::scalar;
+#endif
+}
+
+std::string_view instructionSetName(InstructionSet inSet) {
+	switch (inSet) {
+	case InstructionSet::sse2:		return "SSE2";
+	case InstructionSet::avx2:		return "AVX2";
+	case InstructionSet::avx512:	return "AVX-512";
+	default:						return "scalar";
+	}
+}
+
+std::string_view softeningName(Softening inSoftening) {
+	switch (inSoftening) {
+	case Softening::plummer:		return "plummer";
+	case Softening::spline:			return "spline";
+	default:						return "none";
+	}
+}
+
+directKernel_t selectDirectKernel(InstructionSet inSet, Softening inSoftening) {
+	switch (inSet) {
+#ifdef FORCE_KERNELS_X86
+	case InstructionSet::sse2:		return directAccelerationsSSE2(inSoftening);
+	case InstructionSet::avx2:		return directAccelerationsAVX2(inSoftening);
+	case InstructionSet::avx512:	return directAccelerationsAVX512(inSoftening);
+#endif
+	default:						return directAccelerationsScalar(inSoftening);
+	}
+}
+jerkKernel_t selectJerkKernel(InstructionSet inSet, Softening inSoftening) {
+	switch (inSet) {
+#ifdef FORCE_KERNELS_X86
+	case InstructionSet::sse2:		return directAccelerationsAndJerksSSE2(inSoftening);
+	case InstructionSet::avx2:		return directAccelerationsAndJerksAVX2(inSoftening);
+	case InstructionSet::avx512:	return directAccelerationsAndJerksAVX512(inSoftening);
+#endif
+	default:						return directAccelerationsAndJerksScalar(inSoftening);
+	}
+}
+
+//Function-local statics are initialised exactly once, on first use, and thread-safely, so CPUID is only ever queried once per run.
+InstructionSet activeInstructionSet() {
+	static const InstructionSet detected{ detectInstructionSet() };
+	return detected;
+}
+//One kernel per form of softening, in the order of the Softening enumeration.
+void computeDirectAccelerations(const KernelArguments& inArgs) {
+	static const std::array<directKernel_t, 3> kernels{ selectDirectKernel(activeInstructionSet(), Softening::none),
+		selectDirectKernel(activeInstructionSet(), Softening::plummer), selectDirectKernel(activeInstructionSet(), Softening::spline) };
+	kernels[static_cast<std::size_t>(inArgs.softening)](inArgs);
+}
+void computeDirectAccelerationsAndJerks(const JerkKernelArguments& inArgs) {
+	static const std::array<jerkKernel_t, 3> kernels{ selectJerkKernel(activeInstructionSet(), Softening::none),
+		selectJerkKernel(activeInstructionSet(), Softening::plummer), selectJerkKernel(activeInstructionSet(), Softening::spline) };
+	kernels[static_cast<std::size_t>(inArgs.softening)](inArgs);
+}
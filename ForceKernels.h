@@ -0,0 +1,98 @@
+#ifndef ForceKernels_H
+#define ForceKernels_H
+
+#include <cstddef>
+#include <string_view>
+
+/*
+* The direct summation gravity kernels. These calculate the acceleration on a set of target bodies caused by a set of source bodies,
+* with each target's acceleration given by G * Sum( m_j * (r_j - r_i) / |r_j - r_i|^3 ).
+*
+* Several variants exist, one per instruction set, each processing as many targets at once as fit in a vector register (2 for SSE2, 4 for AVX2, 8 for AVX-512).
+* The best variant the processor supports is chosen once, at startup, via CPUID, so the same executable runs on any x86 machine.
+*
+* Every variant is generated from the same template (see ForceKernelsImpl.h) and performs exactly the same IEEE operations in exactly the same order,
+* without fused multiply-adds, so the vectorised results match the scalar fallback bit-for-bit. The documented tolerance between variants is therefore zero.
+* That relies on the compiler never contracting a multiply and an add into a fused multiply-add, which GCC does by default whenever FMA is enabled, as it
+* is by AVX-512. Each kernel translation unit therefore switches contraction off itself, with a pragma for each compiler, rather than relying on build flags.
+*
+* The pull between two bodies can be softened, so that it stays finite as they pass through each other rather than growing as 1/r^2 without limit.
+* Each form of softening is a policy the kernels are instantiated with (see ForceKernelsImpl.h), so the choice costs nothing inside the loop over pairs:
+* the unsoftened kernel is exactly the one used before softening existed. A pair's softening length is the larger of the two bodies' own lengths.
+*/
+
+//How close encounters are softened. eps is the softening length of a pair.
+enum class Softening {
+	none,				//Newtonian gravity, m d / r^3.
+	plummer,			//The pull of a Plummer sphere of scale length eps, m d / (r^2 + eps^2)^(3/2).
+	spline				//The cubic spline kernel of Monaghan and Lattanzio (1985), as used by GADGET. The mass is spread over a sphere of radius h = 2.8 eps,
+						//which matches the central potential of a Plummer sphere of length eps. Beyond h the pull is exactly Newtonian.
+};
+
+//The arrays a kernel reads from and writes to. Targets and sources are kept separate so that a kernel can be run over any subset of the system.
+struct KernelArguments {
+	const double*	 targetX{ nullptr };			//Positions of the bodies we want the acceleration of.
+	const double*	 targetY{ nullptr };
+	const double*	 targetZ{ nullptr };
+	std::size_t		 targetCount{ 0 };
+
+	const double*	 sourceX{ nullptr };			//Positions and masses of the bodies which cause it.
+	const double*	 sourceY{ nullptr };
+	const double*	 sourceZ{ nullptr };
+	const double*	 sourceMass{ nullptr };
+	std::size_t		 sourceCount{ 0 };
+
+	Softening		 softening{ Softening::none };
+	const double*	 targetSoftening2{ nullptr };	//The squared softening length of each target and source. Only read when softening is not none.
+	const double*	 sourceSoftening2{ nullptr };
+
+	double*			 outX{ nullptr };				//And where to write the result, one entry per target.
+	double*			 outY{ nullptr };
+	double*			 outZ{ nullptr };
+};
+
+//The extra arrays needed to calculate the jerk, the rate of change of the acceleration, alongside it. For each target this is
+//G * Sum( m_j * [ v_ij / |r_ij|^3 - 3 (r_ij . v_ij) r_ij / |r_ij|^5 ] ), with r_ij = r_j - r_i and v_ij = v_j - v_i.
+//Most of the work (the separation, 1/r and m_j/r^3) is shared with the acceleration, so the fused kernel costs far less than two separate passes.
+struct JerkKernelArguments : KernelArguments {
+	const double*	 targetVX{ nullptr };			//Velocities of the targets...
+	const double*	 targetVY{ nullptr };
+	const double*	 targetVZ{ nullptr };
+
+	const double*	 sourceVX{ nullptr };			//...and of the sources.
+	const double*	 sourceVY{ nullptr };
+	const double*	 sourceVZ{ nullptr };
+
+	double*			 outJerkX{ nullptr };			//The jerk of each target, measured in m/s^3.
+	double*			 outJerkY{ nullptr };
+	double*			 outJerkZ{ nullptr };
+};
+
+//Pairs with zero separation (including a body paired with itself) are skipped, so the targets may safely be drawn from the same arrays as the sources.
+using directKernel_t = void(*)(const KernelArguments&);
+using jerkKernel_t = void(*)(const JerkKernelArguments&);
+
+enum class InstructionSet {
+	scalar,
+	sse2,
+	avx2,
+	avx512
+};
+
+//Query the processor (and operating system) for the widest instruction set we can use.
+InstructionSet detectInstructionSet();
+std::string_view instructionSetName(InstructionSet inSet);
+
+std::string_view softeningName(Softening inSoftening);
+
+//Fetch the kernel for a given instruction set and form of softening. Requesting an instruction set which was not detected is the caller's responsibility.
+directKernel_t selectDirectKernel(InstructionSet inSet, Softening inSoftening = Softening::none);
+jerkKernel_t selectJerkKernel(InstructionSet inSet, Softening inSoftening = Softening::none);
+
+//Run the kernel selected for this machine and the softening named in inArgs. Detection happens on the first call only.
+void computeDirectAccelerations(const KernelArguments& inArgs);
+void computeDirectAccelerationsAndJerks(const JerkKernelArguments& inArgs);
+InstructionSet activeInstructionSet();
+
+
+#endif
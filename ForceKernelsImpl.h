@@ -0,0 +1,289 @@
+#ifndef ForceKernelsImpl_H
+#define ForceKernelsImpl_H
+
+#include <cstddef>
+#include <cmath>
+
+#include "ForceKernels.h"
+
+/*
+* The body of the direct summation kernel, written once against a small set of vector operations ("Ops") and instantiated per instruction set.
+* Each Ops type provides a vector type vec_t holding `width` doubles and the handful of operations the kernel needs.
+* This header is meant for the kernel translation units - ForceKernels.cpp and the ForceKernels_<ISA>.cpp files - as each of those is compiled with different instruction set flags.
+* Everything here sits in an anonymous namespace for the same reason: if the instantiations had external linkage, the linker would be free to keep
+* the copy compiled for AVX-512 and call it from the scalar fallback on a machine without AVX-512.
+* The only other users are the scalar pair loops of the pairwise and Barnes-Hut solvers, which borrow ScalarOps and the softening policies below;
+* those files are compiled without special flags, and the anonymous namespace keeps their copies to themselves as well.
+*
+* The kernels are also instantiated once per softening policy. A policy is a small class template over Ops which turns the squared separation of a pair
+* (and their squared softening length) into the factor m g(r) multiplying the separation, and for the jerk kernel into alpha = -(r.v) g'(r) / (r g(r)),
+* so that the jerk is m g(r) (v - alpha r). Anything shared between the two calls is kept in the policy object, which lives only as long as one pair.
+*/
+
+namespace {
+
+//The scalar "vector" of one double. Used for the fallback kernel and for the leftover targets at the end of every vectorised run.
+struct ScalarOps {
+	using vec_t = double;
+	static constexpr std::size_t width{ 1 };
+
+	static vec_t load(const double* inPtr) { return *inPtr; }
+	static void store(double* outPtr, vec_t inValue) { *outPtr = inValue; }
+	static vec_t broadcast(double inValue) { return inValue; }
+	static vec_t add(vec_t a, vec_t b) { return a + b; }
+	static vec_t sub(vec_t a, vec_t b) { return a - b; }
+	static vec_t mul(vec_t a, vec_t b) { return a * b; }
+	static vec_t div(vec_t a, vec_t b) { return a / b; }
+	static vec_t sqrt(vec_t a) { return std::sqrt(a); }
+	//Returns inValue wherever inTest > 0, and zero elsewhere.
+	static vec_t selectPositive(vec_t inTest, vec_t inValue) { return inTest > 0 ? inValue : 0; }
+	//Returns inIfLess wherever a < b, and inOtherwise elsewhere (including where either is NaN).
+	static vec_t selectLess(vec_t a, vec_t b, vec_t inIfLess, vec_t inOtherwise) { return a < b ? inIfLess : inOtherwise; }
+	//The larger of a and b, or b if either is NaN, matching the SSE and AVX max instructions.
+	static vec_t max(vec_t a, vec_t b) { return a > b ? a : b; }
+};
+
+
+//Newtonian gravity, g(r) = 1/r^3. The operations are exactly those of the kernels before softening was added.
+template<typename Ops>
+struct NoSoftening {
+	using vec_t = typename Ops::vec_t;
+	static constexpr bool usesLength{ false };
+
+	vec_t invR;
+
+	vec_t factor(vec_t inMass, vec_t inR2, vec_t) {
+		invR = Ops::div(Ops::broadcast(1.0), Ops::sqrt(inR2));
+		return Ops::mul(Ops::mul(Ops::mul(inMass, invR), invR), invR);
+	}
+	vec_t alpha(vec_t inRV) {
+		return Ops::mul(Ops::mul(Ops::mul(Ops::broadcast(3.0), inRV), invR), invR);
+	}
+};
+
+//Plummer softening, g(r) = 1/(r^2 + eps^2)^(3/2). This is the Newtonian pull with r^2 replaced by r^2 + eps^2, and the same goes for the jerk.
+template<typename Ops>
+struct PlummerSoftening {
+	using vec_t = typename Ops::vec_t;
+	static constexpr bool usesLength{ true };
+
+	NoSoftening<Ops> newtonian;
+
+	vec_t factor(vec_t inMass, vec_t inR2, vec_t inSoftening2) {
+		return newtonian.factor(inMass, Ops::add(inR2, inSoftening2), inSoftening2);
+	}
+	vec_t alpha(vec_t inRV) {
+		return newtonian.alpha(inRV);
+	}
+};
+
+//The cubic spline kernel, with h = 2.8 eps and u = r/h. Following Springel (2005, GADGET-2):
+//	g = (1/h^3) (32/3 + u^2 (32u - 192/5))								for u < 1/2
+//	g = (1/h^3) (64/3 - 48u + (192/5)u^2 - (32/3)u^3 - (1/15)/u^3)		for 1/2 <= u < 1
+//	g = 1/r^3															beyond.
+//Vector lanes can fall in different regions, so all three are evaluated and the right one picked out for each lane.
+template<typename Ops>
+struct SplineSoftening {
+	using vec_t = typename Ops::vec_t;
+	static constexpr bool usesLength{ true };
+
+	vec_t u, invH2, invR, inner, middle;
+
+	vec_t factor(vec_t inMass, vec_t inR2, vec_t inSoftening2) {
+		const vec_t one{ Ops::broadcast(1.0) };
+		const vec_t invH{ Ops::div(one, Ops::sqrt(Ops::mul(Ops::broadcast(2.8 * 2.8), inSoftening2))) };
+		const vec_t r{ Ops::sqrt(inR2) };
+		invH2 = Ops::mul(invH, invH);
+		invR = Ops::div(one, r);
+		u = Ops::mul(r, invH);
+
+		const vec_t u2{ Ops::mul(u, u) };
+		const vec_t u3{ Ops::mul(u2, u) };
+		inner = Ops::add(Ops::broadcast(32.0 / 3.0), Ops::mul(u2, Ops::sub(Ops::mul(Ops::broadcast(32.0), u), Ops::broadcast(192.0 / 5.0))));
+		middle = Ops::sub(Ops::add(Ops::sub(Ops::broadcast(64.0 / 3.0), Ops::mul(Ops::broadcast(48.0), u)), Ops::mul(Ops::broadcast(192.0 / 5.0), u2)),
+			Ops::add(Ops::mul(Ops::broadcast(32.0 / 3.0), u3), Ops::div(Ops::broadcast(1.0 / 15.0), u3)));
+
+		const vec_t invH3{ Ops::mul(invH2, invH) };
+		const vec_t g{ Ops::selectLess(u, Ops::broadcast(0.5), Ops::mul(invH3, inner),
+			Ops::selectLess(u, one, Ops::mul(invH3, middle), Ops::mul(Ops::mul(invR, invR), invR))) };
+		return Ops::mul(inMass, g);
+	}
+	//-g'(r)/(r g(r)) is (1/h^2) (384/5 - 96u) / inner inside u = 1/2, (1/h^2) (48/u - 384/5 + 32u - (1/5)/u^5) / middle out to u = 1, and 3/r^2 beyond.
+	vec_t alpha(vec_t inRV) {
+		const vec_t one{ Ops::broadcast(1.0) };
+		const vec_t invU{ Ops::div(one, u) };
+		const vec_t invU2{ Ops::mul(invU, invU) };
+		const vec_t innerRatio{ Ops::div(Ops::sub(Ops::broadcast(384.0 / 5.0), Ops::mul(Ops::broadcast(96.0), u)), inner) };
+		const vec_t middleRatio{ Ops::div(Ops::sub(Ops::add(Ops::sub(Ops::mul(Ops::broadcast(48.0), invU), Ops::broadcast(384.0 / 5.0)), Ops::mul(Ops::broadcast(32.0), u)),
+			Ops::mul(Ops::broadcast(0.2), Ops::mul(Ops::mul(invU2, invU2), invU))), middle) };
+		const vec_t ratio{ Ops::selectLess(u, Ops::broadcast(0.5), Ops::mul(invH2, innerRatio),
+			Ops::selectLess(u, one, Ops::mul(invH2, middleRatio), Ops::mul(Ops::mul(Ops::broadcast(3.0), invR), invR))) };
+		return Ops::mul(inRV, ratio);
+	}
+};
+
+
+template<typename Ops, template<typename> class Softening>
+void directAccelerationKernel(const KernelArguments& inArgs) {
+	using vec_t = typename Ops::vec_t;
+	constexpr std::size_t width{ Ops::width };
+	constexpr double G{ 6.67408e-11 };						//The same value as Planet::G and BodySystem::G.
+
+	const std::size_t vectorEnd{ inArgs.targetCount - inArgs.targetCount % width };
+	const vec_t zero{ Ops::broadcast(0.0) };
+	const vec_t gravity{ Ops::broadcast(G) };
+
+	//Each pass of the outer loop handles one register's worth of targets, which then sweep over every source together.
+	for (std::size_t i = 0; i < vectorEnd; i += width) {
+		const vec_t xi{ Ops::load(inArgs.targetX + i) };
+		const vec_t yi{ Ops::load(inArgs.targetY + i) };
+		const vec_t zi{ Ops::load(inArgs.targetZ + i) };
+		vec_t softeningI{ zero };
+		if constexpr (Softening<Ops>::usesLength) softeningI = Ops::load(inArgs.targetSoftening2 + i);
+		vec_t sumX{ zero };
+		vec_t sumY{ zero };
+		vec_t sumZ{ zero };
+
+		for (std::size_t j = 0; j < inArgs.sourceCount; ++j) {
+			const vec_t dx{ Ops::sub(Ops::broadcast(inArgs.sourceX[j]), xi) };
+			const vec_t dy{ Ops::sub(Ops::broadcast(inArgs.sourceY[j]), yi) };
+			const vec_t dz{ Ops::sub(Ops::broadcast(inArgs.sourceZ[j]), zi) };
+			const vec_t r2{ Ops::add(Ops::add(Ops::mul(dx, dx), Ops::mul(dy, dy)), Ops::mul(dz, dz)) };
+			vec_t softening2{ zero };
+			if constexpr (Softening<Ops>::usesLength) softening2 = Ops::max(softeningI, Ops::broadcast(inArgs.sourceSoftening2[j]));
+			//m_j g(r), masked to zero where the separation is zero. The mask also discards the infinities 1/sqrt(0) produces.
+			Softening<Ops> pair;
+			const vec_t factor{ Ops::selectPositive(r2, pair.factor(Ops::broadcast(inArgs.sourceMass[j]), r2, softening2)) };
+			sumX = Ops::add(sumX, Ops::mul(factor, dx));
+			sumY = Ops::add(sumY, Ops::mul(factor, dy));
+			sumZ = Ops::add(sumZ, Ops::mul(factor, dz));
+		}
+
+		//G is common to every term, so it is applied once to the sum rather than once per pair.
+		Ops::store(inArgs.outX + i, Ops::mul(gravity, sumX));
+		Ops::store(inArgs.outY + i, Ops::mul(gravity, sumY));
+		Ops::store(inArgs.outZ + i, Ops::mul(gravity, sumZ));
+	}
+
+	//Any targets which don't fill a whole register are passed through the scalar version of the same kernel.
+	if constexpr (width > 1) {
+		if (vectorEnd < inArgs.targetCount) {
+			KernelArguments tailArgs{ inArgs };
+			tailArgs.targetX += vectorEnd;
+			tailArgs.targetY += vectorEnd;
+			tailArgs.targetZ += vectorEnd;
+			if constexpr (Softening<Ops>::usesLength) tailArgs.targetSoftening2 += vectorEnd;
+			tailArgs.targetCount -= vectorEnd;
+			tailArgs.outX += vectorEnd;
+			tailArgs.outY += vectorEnd;
+			tailArgs.outZ += vectorEnd;
+			directAccelerationKernel<ScalarOps, Softening>(tailArgs);
+		}
+	}
+}
+
+
+//The acceleration and jerk together. The acceleration is built up exactly as in directAccelerationKernel, so the two kernels agree on it bit-for-bit.
+template<typename Ops, template<typename> class Softening>
+void directJerkKernel(const JerkKernelArguments& inArgs) {
+	using vec_t = typename Ops::vec_t;
+	constexpr std::size_t width{ Ops::width };
+	constexpr double G{ 6.67408e-11 };
+
+	const std::size_t vectorEnd{ inArgs.targetCount - inArgs.targetCount % width };
+	const vec_t zero{ Ops::broadcast(0.0) };
+	const vec_t gravity{ Ops::broadcast(G) };
+
+	for (std::size_t i = 0; i < vectorEnd; i += width) {
+		const vec_t xi{ Ops::load(inArgs.targetX + i) };
+		const vec_t yi{ Ops::load(inArgs.targetY + i) };
+		const vec_t zi{ Ops::load(inArgs.targetZ + i) };
+		const vec_t vxi{ Ops::load(inArgs.targetVX + i) };
+		const vec_t vyi{ Ops::load(inArgs.targetVY + i) };
+		const vec_t vzi{ Ops::load(inArgs.targetVZ + i) };
+		vec_t softeningI{ zero };
+		if constexpr (Softening<Ops>::usesLength) softeningI = Ops::load(inArgs.targetSoftening2 + i);
+		vec_t sumX{ zero };
+		vec_t sumY{ zero };
+		vec_t sumZ{ zero };
+		vec_t jerkX{ zero };
+		vec_t jerkY{ zero };
+		vec_t jerkZ{ zero };
+
+		for (std::size_t j = 0; j < inArgs.sourceCount; ++j) {
+			const vec_t dx{ Ops::sub(Ops::broadcast(inArgs.sourceX[j]), xi) };
+			const vec_t dy{ Ops::sub(Ops::broadcast(inArgs.sourceY[j]), yi) };
+			const vec_t dz{ Ops::sub(Ops::broadcast(inArgs.sourceZ[j]), zi) };
+			const vec_t dvx{ Ops::sub(Ops::broadcast(inArgs.sourceVX[j]), vxi) };
+			const vec_t dvy{ Ops::sub(Ops::broadcast(inArgs.sourceVY[j]), vyi) };
+			const vec_t dvz{ Ops::sub(Ops::broadcast(inArgs.sourceVZ[j]), vzi) };
+			const vec_t r2{ Ops::add(Ops::add(Ops::mul(dx, dx), Ops::mul(dy, dy)), Ops::mul(dz, dz)) };
+			vec_t softening2{ zero };
+			if constexpr (Softening<Ops>::usesLength) softening2 = Ops::max(softeningI, Ops::broadcast(inArgs.sourceSoftening2[j]));
+			Softening<Ops> pair;
+			const vec_t factor{ Ops::selectPositive(r2, pair.factor(Ops::broadcast(inArgs.sourceMass[j]), r2, softening2)) };
+			sumX = Ops::add(sumX, Ops::mul(factor, dx));
+			sumY = Ops::add(sumY, Ops::mul(factor, dy));
+			sumZ = Ops::add(sumZ, Ops::mul(factor, dz));
+
+			//3 (r . v) / r^2 when unsoftened, masked like the factor so that a zero separation contributes nothing rather than 0 * infinity.
+			const vec_t rv{ Ops::add(Ops::add(Ops::mul(dx, dvx), Ops::mul(dy, dvy)), Ops::mul(dz, dvz)) };
+			const vec_t alpha{ Ops::selectPositive(r2, pair.alpha(rv)) };
+			jerkX = Ops::add(jerkX, Ops::mul(factor, Ops::sub(dvx, Ops::mul(alpha, dx))));
+			jerkY = Ops::add(jerkY, Ops::mul(factor, Ops::sub(dvy, Ops::mul(alpha, dy))));
+			jerkZ = Ops::add(jerkZ, Ops::mul(factor, Ops::sub(dvz, Ops::mul(alpha, dz))));
+		}
+
+		Ops::store(inArgs.outX + i, Ops::mul(gravity, sumX));
+		Ops::store(inArgs.outY + i, Ops::mul(gravity, sumY));
+		Ops::store(inArgs.outZ + i, Ops::mul(gravity, sumZ));
+		Ops::store(inArgs.outJerkX + i, Ops::mul(gravity, jerkX));
+		Ops::store(inArgs.outJerkY + i, Ops::mul(gravity, jerkY));
+		Ops::store(inArgs.outJerkZ + i, Ops::mul(gravity, jerkZ));
+	}
+
+	if constexpr (width > 1) {
+		if (vectorEnd < inArgs.targetCount) {
+			JerkKernelArguments tailArgs{ inArgs };
+			tailArgs.targetX += vectorEnd;
+			tailArgs.targetY += vectorEnd;
+			tailArgs.targetZ += vectorEnd;
+			tailArgs.targetVX += vectorEnd;
+			tailArgs.targetVY += vectorEnd;
+			tailArgs.targetVZ += vectorEnd;
+			if constexpr (Softening<Ops>::usesLength) tailArgs.targetSoftening2 += vectorEnd;
+			tailArgs.targetCount -= vectorEnd;
+			tailArgs.outX += vectorEnd;
+			tailArgs.outY += vectorEnd;
+			tailArgs.outZ += vectorEnd;
+			tailArgs.outJerkX += vectorEnd;
+			tailArgs.outJerkY += vectorEnd;
+			tailArgs.outJerkZ += vectorEnd;
+			directJerkKernel<ScalarOps, Softening>(tailArgs);
+		}
+	}
+}
+
+
+//The instantiations of each kernel for one instruction set, picked by the softening asked for.
+template<typename Ops>
+directKernel_t directKernelFor(Softening inSoftening) {
+	switch (inSoftening) {
+	case Softening::plummer:	return &directAccelerationKernel<Ops, PlummerSoftening>;
+	case Softening::spline:		return &directAccelerationKernel<Ops, SplineSoftening>;
+	default:					return &directAccelerationKernel<Ops, NoSoftening>;
+	}
+}
+template<typename Ops>
+jerkKernel_t jerkKernelFor(Softening inSoftening) {
+	switch (inSoftening) {
+	case Softening::plummer:	return &directJerkKernel<Ops, PlummerSoftening>;
+	case Softening::spline:		return &directJerkKernel<Ops, SplineSoftening>;
+	default:					return &directJerkKernel<Ops, NoSoftening>;
+	}
+}
+
+}
+
+
+#endif
\ No newline at end of file
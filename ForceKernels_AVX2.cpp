@@ -0,0 +1,51 @@
+//The AVX2 variant of the direct summation kernel, processing four targets at a time.
+//This file must be compiled with AVX2 enabled (/arch:AVX2 on MSVC, which the project sets for this file only, or -mavx2 elsewhere).
+//FMA is deliberately left disabled, and contraction switched off below in case a build enables it anyway, so the results match the scalar kernel exactly.
+
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+#if !defined(__AVX2__)
+#error "ForceKernels_AVX2.cpp must be compiled with AVX2 enabled."
+#endif
+
+#include <immintrin.h>
+
+#include "ForceKernelsImpl.h"
+
+namespace {
+
+struct Avx2Ops {
+	using vec_t = __m256d;
+	static constexpr std::size_t width{ 4 };
+
+	static vec_t load(const double* inPtr) { return _mm256_loadu_pd(inPtr); }
+	static void store(double* outPtr, vec_t inValue) { _mm256_storeu_pd(outPtr, inValue); }
+	static vec_t broadcast(double inValue) { return _mm256_set1_pd(inValue); }
+	static vec_t add(vec_t a, vec_t b) { return _mm256_add_pd(a, b); }
+	static vec_t sub(vec_t a, vec_t b) { return _mm256_sub_pd(a, b); }
+	static vec_t mul(vec_t a, vec_t b) { return _mm256_mul_pd(a, b); }
+	static vec_t div(vec_t a, vec_t b) { return _mm256_div_pd(a, b); }
+	static vec_t sqrt(vec_t a) { return _mm256_sqrt_pd(a); }
+	static vec_t selectPositive(vec_t inTest, vec_t inValue) { return _mm256_and_pd(_mm256_cmp_pd(inTest, _mm256_setzero_pd(), _CMP_GT_OQ), inValue); }
+	static vec_t selectLess(vec_t a, vec_t b, vec_t inIfLess, vec_t inOtherwise) { return _mm256_blendv_pd(inOtherwise, inIfLess, _mm256_cmp_pd(a, b, _CMP_LT_OQ)); }
+	static vec_t max(vec_t a, vec_t b) { return _mm256_max_pd(a, b); }
+};
+
+}
+
+directKernel_t directAccelerationsAVX2(Softening inSoftening) {
+	return directKernelFor<Avx2Ops>(inSoftening);
+}
+jerkKernel_t directAccelerationsAndJerksAVX2(Softening inSoftening) {
+	return jerkKernelFor<Avx2Ops>(inSoftening);
+}
+
+#endif
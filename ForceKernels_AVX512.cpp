@@ -0,0 +1,51 @@
+//The AVX-512 variant of the direct summation kernel, processing eight targets at a time.
+//This file must be compiled with AVX-512 enabled (/arch:AVX512 on MSVC, which the project sets for this file only, or -mavx512f elsewhere).
+//AVX-512 implies FMA, so contraction into fused multiply-adds is switched off below, whatever the build flags, as the results must match the scalar kernel exactly.
+
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+#if !defined(__AVX512F__)
+#error "ForceKernels_AVX512.cpp must be compiled with AVX-512 enabled."
+#endif
+
+#include <immintrin.h>
+
+#include "ForceKernelsImpl.h"
+
+namespace {
+
+struct Avx512Ops {
+	using vec_t = __m512d;
+	static constexpr std::size_t width{ 8 };
+
+	static vec_t load(const double* inPtr) { return _mm512_loadu_pd(inPtr); }
+	static void store(double* outPtr, vec_t inValue) { _mm512_storeu_pd(outPtr, inValue); }
+	static vec_t broadcast(double inValue) { return _mm512_set1_pd(inValue); }
+	static vec_t add(vec_t a, vec_t b) { return _mm512_add_pd(a, b); }
+	static vec_t sub(vec_t a, vec_t b) { return _mm512_sub_pd(a, b); }
+	static vec_t mul(vec_t a, vec_t b) { return _mm512_mul_pd(a, b); }
+	static vec_t div(vec_t a, vec_t b) { return _mm512_div_pd(a, b); }
+	static vec_t sqrt(vec_t a) { return _mm512_sqrt_pd(a); }
+	static vec_t selectPositive(vec_t inTest, vec_t inValue) { return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(inTest, _mm512_setzero_pd(), _CMP_GT_OQ), _mm512_setzero_pd(), inValue); }
+	static vec_t selectLess(vec_t a, vec_t b, vec_t inIfLess, vec_t inOtherwise) { return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(a, b, _CMP_LT_OQ), inOtherwise, inIfLess); }
+	static vec_t max(vec_t a, vec_t b) { return _mm512_max_pd(a, b); }
+};
+
+}
+
+directKernel_t directAccelerationsAVX512(Softening inSoftening) {
+	return directKernelFor<Avx512Ops>(inSoftening);
+}
+jerkKernel_t directAccelerationsAndJerksAVX512(Softening inSoftening) {
+	return jerkKernelFor<Avx512Ops>(inSoftening);
+}
+
+#endif
@@ -0,0 +1,49 @@
+//The SSE2 variant of the direct summation kernel, processing two targets at a time.
+//SSE2 is part of the x86-64 baseline, so this file needs no special compiler flags. Contraction is switched off as in the other variants.
+
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+#include <emmintrin.h>
+
+#include "ForceKernelsImpl.h"
+
+namespace {
+
+struct Sse2Ops {
+	using vec_t = __m128d;
+	static constexpr std::size_t width{ 2 };
+
+	static vec_t load(const double* inPtr) { return _mm_loadu_pd(inPtr); }
+	static void store(double* outPtr, vec_t inValue) { _mm_storeu_pd(outPtr, inValue); }
+	static vec_t broadcast(double inValue) { return _mm_set1_pd(inValue); }
+	static vec_t add(vec_t a, vec_t b) { return _mm_add_pd(a, b); }
+	static vec_t sub(vec_t a, vec_t b) { return _mm_sub_pd(a, b); }
+	static vec_t mul(vec_t a, vec_t b) { return _mm_mul_pd(a, b); }
+	static vec_t div(vec_t a, vec_t b) { return _mm_div_pd(a, b); }
+	static vec_t sqrt(vec_t a) { return _mm_sqrt_pd(a); }
+	static vec_t selectPositive(vec_t inTest, vec_t inValue) { return _mm_and_pd(_mm_cmpgt_pd(inTest, _mm_setzero_pd()), inValue); }
+	static vec_t selectLess(vec_t a, vec_t b, vec_t inIfLess, vec_t inOtherwise) {
+		const vec_t mask{ _mm_cmplt_pd(a, b) };
+		return _mm_or_pd(_mm_and_pd(mask, inIfLess), _mm_andnot_pd(mask, inOtherwise));
+	}
+	static vec_t max(vec_t a, vec_t b) { return _mm_max_pd(a, b); }
+};
+
+}
+
+directKernel_t directAccelerationsSSE2(Softening inSoftening) {
+	return directKernelFor<Sse2Ops>(inSoftening);
+}
+jerkKernel_t directAccelerationsAndJerksSSE2(Softening inSoftening) {
+	return jerkKernelFor<Sse2Ops>(inSoftening);
+}
+
+#endif
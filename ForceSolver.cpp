@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ForceSolver.h"
+#include "ForceKernels.h"
+#include "ForceKernelsImpl.h"
+#include "BarnesHut.h"
+#include "FastMultipole.h"
+
+
+ForceSolver::ForceSolver(ThreadPool& inPool, Softening inSoftening) : m_pool{ &inPool }, m_softening{ inSoftening } {}
+
+void ForceSolver::computeAccelerations(BodySystem& inBodies) const {
+	computeAccelerations(inBodies, inBodies.state(), inBodies.accelerations());
+}
+ThreadPool& ForceSolver::pool() const {
+	return *m_pool;
+}
+Softening ForceSolver::softening() const {
+	return m_softening;
+}
+void ForceSolver::computeSubsetAccelerations(const BodySystem& inBodies, const BodyState& inState, const std::vector<std::uint32_t>& inTargets, AccelerationBuffer& outAcc) const {
+	AccelerationBuffer everyBody;
+	computeAccelerations(inBodies, inState, everyBody);
+	for (const std::uint32_t i : inTargets) {
+		outAcc.ax[i] = everyBody.ax[i];
+		outAcc.ay[i] = everyBody.ay[i];
+		outAcc.az[i] = everyBody.az[i];
+	}
+}
+void ForceSolver::computeAccelerationsAndJerks(const BodySystem&, const BodyState&, AccelerationBuffer&, AccelerationBuffer&) const {
+	std::cerr << "Error in config file. Force solver " << name() << " cannot calculate jerks. The Hermite integrator needs forceSolver=direct.\n";
+	throw std::invalid_argument("Error: forceSolver in config.txt does not support the chosen integrator");
+}
+
+
+//Direct summation solver. Every body is a target and every massive body a source; the kernel skips the zero-separation pair of a body with itself.
+DirectSolver::DirectSolver(ThreadPool& inPool, Softening inSoftening) : ForceSolver{ inPool, inSoftening } {}
+
+void DirectSolver::computeAccelerations(const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc) const {
+	outAcc.resize(inState.size());
+
+	//Each block of targets is a kernel call of its own against every source. Blocks are a multiple of the widest vector so only the last one has a scalar tail.
+	m_pool->parallelFor(inState.size(), 64, [&](std::size_t inBegin, std::size_t inEnd) {
+		KernelArguments args;
+		args.targetX = inState.x.data() + inBegin;
+		args.targetY = inState.y.data() + inBegin;
+		args.targetZ = inState.z.data() + inBegin;
+		args.targetCount = inEnd - inBegin;
+		args.sourceX = inState.x.data();
+		args.sourceY = inState.y.data();
+		args.sourceZ = inState.z.data();
+		args.sourceMass = inBodies.masses().data();
+		args.sourceCount = inBodies.activeCount();
+		args.softening = m_softening;
+		args.targetSoftening2 = inBodies.softening2().data() + inBegin;
+		args.sourceSoftening2 = inBodies.softening2().data();
+		args.outX = outAcc.ax.data() + inBegin;
+		args.outY = outAcc.ay.data() + inBegin;
+		args.outZ = outAcc.az.data() + inBegin;
+		computeDirectAccelerations(args);
+	});
+}
+//The targets are gathered into contiguous arrays so the kernel can still be used, and the results scattered back to where they belong.
+//The block integrator calls this every substep, so the arrays are fixed-size ones on the stack, reused for each run of subsetChunk targets, rather than
+//being allocated afresh.
+void DirectSolver::computeSubsetAccelerations(const BodySystem& inBodies, const BodyState& inState, const std::vector<std::uint32_t>& inTargets, AccelerationBuffer& outAcc) const {
+	m_pool->parallelFor(inTargets.size(), subsetChunk, [&](std::size_t inBegin, std::size_t inEnd) {
+		alignas(64) std::array<double, subsetChunk> targetX;
+		alignas(64) std::array<double, subsetChunk> targetY;
+		alignas(64) std::array<double, subsetChunk> targetZ;
+		alignas(64) std::array<double, subsetChunk> targetSoftening2;
+		alignas(64) std::array<double, subsetChunk> resultX;
+		alignas(64) std::array<double, subsetChunk> resultY;
+		alignas(64) std::array<double, subsetChunk> resultZ;
+
+		KernelArguments args;
+		args.targetX = targetX.data();
+		args.targetY = targetY.data();
+		args.targetZ = targetZ.data();
+		args.sourceX = inState.x.data();
+		args.sourceY = inState.y.data();
+		args.sourceZ = inState.z.data();
+		args.sourceMass = inBodies.masses().data();
+		args.sourceCount = inBodies.activeCount();
+		args.softening = m_softening;
+		args.targetSoftening2 = targetSoftening2.data();
+		args.sourceSoftening2 = inBodies.softening2().data();
+		args.outX = resultX.data();
+		args.outY = resultY.data();
+		args.outZ = resultZ.data();
+
+		for (std::size_t chunkBegin = inBegin; chunkBegin < inEnd; chunkBegin += subsetChunk) {
+			const std::size_t chunkSize{ std::min(subsetChunk, inEnd - chunkBegin) };
+			for (std::size_t k = 0; k < chunkSize; ++k) {
+				const std::uint32_t i{ inTargets[chunkBegin + k] };
+				targetX[k] = inState.x[i];
+				targetY[k] = inState.y[i];
+				targetZ[k] = inState.z[i];
+				targetSoftening2[k] = inBodies.softening2()[i];
+			}
+			args.targetCount = chunkSize;
+			computeDirectAccelerations(args);
+
+			for (std::size_t k = 0; k < chunkSize; ++k) {
+				const std::uint32_t i{ inTargets[chunkBegin + k] };
+				outAcc.ax[i] = resultX[k];
+				outAcc.ay[i] = resultY[k];
+				outAcc.az[i] = resultZ[k];
+			}
+		}
+	});
+}
+//The same blocks as computeAccelerations, through the fused acceleration and jerk kernel.
+void DirectSolver::computeAccelerationsAndJerks(const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc, AccelerationBuffer& outJerk) const {
+	outAcc.resize(inState.size());
+	outJerk.resize(inState.size());
+
+	m_pool->parallelFor(inState.size(), 64, [&](std::size_t inBegin, std::size_t inEnd) {
+		JerkKernelArguments args;
+		args.targetX = inState.x.data() + inBegin;
+		args.targetY = inState.y.data() + inBegin;
+		args.targetZ = inState.z.data() + inBegin;
+		args.targetVX = inState.vx.data() + inBegin;
+		args.targetVY = inState.vy.data() + inBegin;
+		args.targetVZ = inState.vz.data() + inBegin;
+		args.targetCount = inEnd - inBegin;
+		args.sourceX = inState.x.data();
+		args.sourceY = inState.y.data();
+		args.sourceZ = inState.z.data();
+		args.sourceVX = inState.vx.data();
+		args.sourceVY = inState.vy.data();
+		args.sourceVZ = inState.vz.data();
+		args.sourceMass = inBodies.masses().data();
+		args.sourceCount = inBodies.activeCount();
+		args.softening = m_softening;
+		args.targetSoftening2 = inBodies.softening2().data() + inBegin;
+		args.sourceSoftening2 = inBodies.softening2().data();
+		args.outX = outAcc.ax.data() + inBegin;
+		args.outY = outAcc.ay.data() + inBegin;
+		args.outZ = outAcc.az.data() + inBegin;
+		args.outJerkX = outJerk.ax.data() + inBegin;
+		args.outJerkY = outJerk.ay.data() + inBegin;
+		args.outJerkZ = outJerk.az.data() + inBegin;
+		computeDirectAccelerationsAndJerks(args);
+	});
+}
+std::string_view DirectSolver::name() const {
+	return "direct";
+}
+
+
+namespace {
+
+//Accumulate Sum( m_j g(r) d ) over every pair (i,j) with i in [rowBegin, rowEnd) and i < j < count, into the (already zeroed) output arrays.
+//g(r) is 1/r^3 unless softened, using the scalar versions of the kernels' softening policies. G is left out and applied once the partial sums have been combined.
+template<template<typename> class Softening>
+void accumulatePairs(const BodyState& inState, const double* mass, const double* softening2, std::size_t count, std::size_t rowBegin, std::size_t rowEnd,
+	double* ax, double* ay, double* az) {
+	const double* x{ inState.x.data() };
+	const double* y{ inState.y.data() };
+	const double* z{ inState.z.data() };
+
+	for (std::size_t i = rowBegin; i < rowEnd; ++i) {
+		const double xi{ x[i] };
+		const double yi{ y[i] };
+		const double zi{ z[i] };
+		const double mi{ mass[i] };
+		double sumX{ 0 };
+		double sumY{ 0 };
+		double sumZ{ 0 };
+		for (std::size_t j = i + 1; j < count; ++j) {
+			const double dx{ x[j] - xi };
+			const double dy{ y[j] - yi };
+			const double dz{ z[j] - zi };
+			const double r2{ dx * dx + dy * dy + dz * dz };
+			if (r2 <= 0) continue;													//Coincident bodies exert no force on each other, as in the direct kernel.
+			double pairSoftening2{ 0 };
+			if constexpr (Softening<ScalarOps>::usesLength) pairSoftening2 = ScalarOps::max(softening2[i], softening2[j]);
+			Softening<ScalarOps> pair;
+			const double invR3{ pair.factor(1.0, r2, pairSoftening2) };
+			//The pull of j on i, and the equal and opposite pull of i on j.
+			sumX += mass[j] * invR3 * dx;
+			sumY += mass[j] * invR3 * dy;
+			sumZ += mass[j] * invR3 * dz;
+			ax[j] -= mi * invR3 * dx;
+			ay[j] -= mi * invR3 * dy;
+			az[j] -= mi * invR3 * dz;
+		}
+		ax[i] += sumX;
+		ay[i] += sumY;
+		az[i] += sumZ;
+	}
+}
+
+//Split the rows of the pair triangle into inParts bands holding roughly equal numbers of pairs. Row i holds (count - 1 - i) pairs,
+//so the early bands are narrower than the later ones. Returns inParts + 1 boundaries.
+std::vector<std::size_t> partitionRows(std::size_t count, std::size_t inParts) {
+	std::vector<std::size_t> bounds(inParts + 1, count);
+	bounds[0] = 0;
+	const double totalPairs{ 0.5 * static_cast<double>(count) * static_cast<double>(count - 1) };
+	double pairsSoFar{ 0 };
+	std::size_t part{ 1 };
+	for (std::size_t i = 0; i < count && part < inParts; ++i) {
+		pairsSoFar += static_cast<double>(count - 1 - i);
+		if (pairsSoFar >= totalPairs * static_cast<double>(part) / static_cast<double>(inParts)) {
+			bounds[part++] = i + 1;
+		}
+	}
+	return bounds;
+}
+
+}
+
+
+PairwiseSolver::PairwiseSolver(ThreadPool& inPool, Softening inSoftening) : ForceSolver{ inPool, inSoftening } {}
+
+void PairwiseSolver::computeAccelerations(const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc) const {
+	constexpr double G{ BodySystem::G };
+	const std::size_t count{ inBodies.activeCount() };				//The pair triangle covers the massive bodies only.
+	const double* mass{ inBodies.masses().data() };
+	const double* softening2{ inBodies.softening2().data() };
+	//The softening policy is picked once here, rather than inside the loop over pairs.
+	const auto accumulate{ [&](std::size_t inRowBegin, std::size_t inRowEnd, double* outX, double* outY, double* outZ) {
+		switch (m_softening) {
+		case Softening::plummer:	accumulatePairs<PlummerSoftening>(inState, mass, softening2, count, inRowBegin, inRowEnd, outX, outY, outZ); break;
+		case Softening::spline:		accumulatePairs<SplineSoftening>(inState, mass, softening2, count, inRowBegin, inRowEnd, outX, outY, outZ); break;
+		default:					accumulatePairs<NoSoftening>(inState, mass, softening2, count, inRowBegin, inRowEnd, outX, outY, outZ); break;
+		}
+	} };
+
+	outAcc.resize(inState.size());
+	std::fill(outAcc.ax.begin(), outAcc.ax.begin() + count, 0.0);
+	std::fill(outAcc.ay.begin(), outAcc.ay.begin() + count, 0.0);
+	std::fill(outAcc.az.begin(), outAcc.az.begin() + count, 0.0);
+
+	//There is no point sharing the work between more bands than there are rows to share out.
+	const std::size_t bandCount{ std::min(m_pool->size(), count / 2 + 1) };
+	if (bandCount <= 1) {
+		accumulate(0, count, outAcc.ax.data(), outAcc.ay.data(), outAcc.az.data());
+	}
+	else {
+		//The first band accumulates straight into the output, every other band into a private buffer of its own.
+		const std::vector<std::size_t> bounds{ partitionRows(count, bandCount) };
+		std::vector<AccelerationBuffer> partialSums(bandCount - 1);
+		m_pool->run(bandCount, [&](std::size_t inBand) {
+			if (inBand == 0) {
+				accumulate(bounds[0], bounds[1], outAcc.ax.data(), outAcc.ay.data(), outAcc.az.data());
+				return;
+			}
+			AccelerationBuffer& buffer{ partialSums[inBand - 1] };
+			buffer.resize(count);
+			accumulate(bounds[inBand], bounds[inBand + 1], buffer.ax.data(), buffer.ay.data(), buffer.az.data());
+		});
+
+		//Reduce in a fixed order so the rounding is the same every run.
+		for (const auto& buffer : partialSums) {
+			for (std::size_t i = 0; i < count; ++i) {
+				outAcc.ax[i] += buffer.ax[i];
+				outAcc.ay[i] += buffer.ay[i];
+				outAcc.az[i] += buffer.az[i];
+			}
+		}
+	}
+
+	for (std::size_t i = 0; i < count; ++i) {
+		outAcc.ax[i] *= G;
+		outAcc.ay[i] *= G;
+		outAcc.az[i] *= G;
+	}
+
+	//The test particles, each pulled by every massive body through the direct kernel. The kernel includes G itself.
+	m_pool->parallelFor(inState.size() - count, 64, [&](std::size_t inBegin, std::size_t inEnd) {
+		KernelArguments args;
+		args.targetX = inState.x.data() + count + inBegin;
+		args.targetY = inState.y.data() + count + inBegin;
+		args.targetZ = inState.z.data() + count + inBegin;
+		args.targetCount = inEnd - inBegin;
+		args.sourceX = inState.x.data();
+		args.sourceY = inState.y.data();
+		args.sourceZ = inState.z.data();
+		args.sourceMass = mass;
+		args.sourceCount = count;
+		args.softening = m_softening;
+		args.targetSoftening2 = softening2 + count + inBegin;
+		args.sourceSoftening2 = softening2;
+		args.outX = outAcc.ax.data() + count + inBegin;
+		args.outY = outAcc.ay.data() + count + inBegin;
+		args.outZ = outAcc.az.data() + count + inBegin;
+		computeDirectAccelerations(args);
+	});
+}
+std::string_view PairwiseSolver::name() const {
+	return "pairwise";
+}
+
+
+std::unique_ptr<ForceSolver> makeForceSolver(const SimulationSettings& inSettings, ThreadPool& inPool) {
+	Softening softening{ Softening::none };
+	if (inSettings.softening == "plummer") softening = Softening::plummer;
+	else if (inSettings.softening == "spline") softening = Softening::spline;
+	else if (inSettings.softening != "none") {
+		std::cerr << "Error in config file. Softening " << inSettings.softening << " is not recognised.\n";
+		throw std::invalid_argument("Error: unknown softening in config.txt");
+	}
+
+	const std::string& name{ inSettings.forceSolver };
+	if (name == "direct") return std::make_unique<DirectSolver>(inPool, softening);
+	if (name == "pairwise") return std::make_unique<PairwiseSolver>(inPool, softening);
+	if (name == "barnesHut") return std::make_unique<BarnesHutSolver>(inSettings.theta, inSettings.quadrupole, inPool, softening);
+	if (name == "fmm") {
+		if (softening != Softening::none) {
+			std::cerr << "Error in config file. The fmm force solver does not support softening. Use barnesHut, pairwise or direct instead.\n";
+			throw std::invalid_argument("Error: softening in config.txt is not supported by the chosen forceSolver");
+		}
+		if (inSettings.expansionOrder < 1 || inSettings.expansionOrder > FastMultipoleSolver::maxOrder) {
+			std::cerr << "Error in config file. Expansion order " << inSettings.expansionOrder << " must be between 1 and " << FastMultipoleSolver::maxOrder << ".\n";
+			throw std::invalid_argument("Error: expansionOrder in config.txt out of range");
+		}
+		return std::make_unique<FastMultipoleSolver>(inSettings.theta, inSettings.expansionOrder, inPool);
+	}
+
+	std::cerr << "Error in config file. Force solver " << name << " is not recognised.\n";
+	throw std::invalid_argument("Error: unknown forceSolver in config.txt");
+}
@@ -0,0 +1,99 @@
+#ifndef ForceSolver_H
+#define ForceSolver_H
+
+#include <memory>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "BodySystem.h"
+#include "ForceKernels.h"
+#include "SimulationSettings.h"
+#include "ThreadPool.h"
+
+/*
+* A force solver calculates the gravitational acceleration of every body in a system from one snapshot of their positions.
+* Solvers never modify the positions they are given, so every body sees every other body at the same time level,
+* and integrators are free to evaluate forces at trial states they hold themselves rather than the system's own state.
+*
+* Only the massive bodies at the front of the system (see BodySystem::activeCount) act as sources. Test particles after them are targets alone, and feel every massive body.
+*
+* Each solver is built with a form of softening (see ForceKernels.h), which it applies using the softening lengths held in the BodySystem.
+*
+* Solvers are stateless between calls, so a single solver may be used from several threads at once.
+* Each solver shares its work between the threads of the pool it was built with (see ThreadPool.h). Without one, it runs on the calling thread alone.
+*/
+
+class ForceSolver
+{
+protected:
+	ThreadPool* m_pool;
+	Softening	m_softening;
+
+public:
+	explicit ForceSolver(ThreadPool& inPool = ThreadPool::serial(), Softening inSoftening = Softening::none);
+	//Virtual default destructor as the solvers are used through base class pointers.
+	virtual ~ForceSolver() = default;
+
+	//Calculate the acceleration of every body from the positions in inState, using the masses in inBodies, and write them to outAcc.
+	virtual void computeAccelerations(const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc) const = 0;
+	//The same, for the system's own state and acceleration arrays.
+	void computeAccelerations(BodySystem& inBodies) const;
+	//Calculate the accelerations of only the bodies listed in inTargets, still feeling the pull of every body. outAcc must already be sized for the whole system,
+	//and the entries of bodies not listed are left untouched. The default works out every body's acceleration and copies out the ones asked for,
+	//so solvers which can do less work for fewer targets override it.
+	virtual void computeSubsetAccelerations(const BodySystem& inBodies, const BodyState& inState, const std::vector<std::uint32_t>& inTargets, AccelerationBuffer& outAcc) const;
+	//Calculate the acceleration and the jerk (its rate of change, which also needs the velocities in inState) of every body, for the Hermite integrator.
+	//The jerk has the same three components as an acceleration, so it is held in an AccelerationBuffer too. Only solvers which override this support it;
+	//the default throws std::invalid_argument.
+	virtual void computeAccelerationsAndJerks(const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc, AccelerationBuffer& outJerk) const;
+
+	virtual std::string_view name() const = 0;
+	ThreadPool& pool() const;
+	Softening softening() const;
+};
+
+
+//The direct summation solver. Every target is visited against every source using the vectorised kernels from ForceKernels.h.
+//Every body is a target but only the massive bodies are sources, so test particles cost one row of the kernel each and nothing more.
+//The targets are split into blocks which the threads of the pool work through independently, so the result does not depend on the number of threads.
+class DirectSolver : public ForceSolver
+{
+public:
+	static constexpr std::size_t subsetChunk{ 64 };		//The most targets computeSubsetAccelerations gathers for one kernel call. A multiple of the widest vector.
+
+	explicit DirectSolver(ThreadPool& inPool = ThreadPool::serial(), Softening inSoftening = Softening::none);
+
+	void computeAccelerations(const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc) const override;
+	void computeSubsetAccelerations(const BodySystem& inBodies, const BodyState& inState, const std::vector<std::uint32_t>& inTargets, AccelerationBuffer& outAcc) const override;
+	void computeAccelerationsAndJerks(const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc, AccelerationBuffer& outJerk) const override;
+	std::string_view name() const override;
+};
+
+
+/*
+* A direct summation solver which uses Newton's third law to visit each unordered pair of bodies only once.
+* The force between bodies i and j is equal and opposite, so one evaluation gives both a_i += G m_j d/r^3 and a_j -= G m_i d/r^3.
+* This halves the number of pair evaluations compared to the DirectSolver, although the scattered writes to a_j make it harder to vectorise.
+* Only pairs of massive bodies are visited this way. Test particles have no reaction to share, so they go through the direct kernel against the massive bodies instead.
+*
+* When run on several threads, the pair triangle is split into one contiguous band of rows per thread of the pool, and each band accumulates into its own private buffer.
+* The buffers are then summed in band order, so the result is the same on every run for a given thread count.
+*/
+class PairwiseSolver : public ForceSolver
+{
+public:
+	explicit PairwiseSolver(ThreadPool& inPool = ThreadPool::serial(), Softening inSoftening = Softening::none);
+
+	void computeAccelerations(const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc) const override;
+	std::string_view name() const override;
+};
+
+
+//Create the solver named in the settings read from config.txt, sharing its work over inPool and softened as they say.
+//Throws std::invalid_argument for unrecognised names, and for softening with a solver which does not support it.
+std::unique_ptr<ForceSolver> makeForceSolver(const SimulationSettings& inSettings, ThreadPool& inPool);
+
+
+#endif
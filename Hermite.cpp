@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "Hermite.h"
+
+namespace {
+	constexpr std::size_t updateGrain{ 4096 };
+	//The step may at most double from one step to the next, so that one quiet step cannot throw the next far out.
+	constexpr double maximumGrowth{ 2.0 };
+
+	double length(double inX, double inY, double inZ) {
+		return std::sqrt(inX * inX + inY * inY + inZ * inZ);
+	}
+}
+
+
+HermiteIntegrator::HermiteIntegrator(double inAccuracy, ThreadPool& inPool) : Integrator{ inPool }, m_accuracy{ inAccuracy } {}
+
+void HermiteIntegrator::step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) {
+	if (!m_initialised) initialise(inBodies, inSolver, inTimeStep);
+
+	//Take steps of the size the criterion asks for until the next would reach the output time, then one to land on it.
+	double elapsed{ 0 };
+	bool finished{ false };
+	while (!finished) {
+		double stepSize{ std::min(m_stepSize, inTimeStep) };
+		if (elapsed + stepSize >= inTimeStep) {
+			stepSize = inTimeStep - elapsed;
+			finished = true;
+		}
+		hermiteStep(inBodies, inSolver, stepSize);
+		elapsed += stepSize;
+
+		//A step shortened to land on the output time is no guide to the next, so the criterion's answer only grows from the longer of the two.
+		double shortestBodyStep{ std::numeric_limits<double>::infinity() };
+		for (const double bodyStep : m_bodyStep) shortestBodyStep = std::min(shortestBodyStep, bodyStep);
+		m_stepSize = std::min(shortestBodyStep, maximumGrowth * std::max(stepSize, m_stepSize));
+		checkStepSize(m_stepSize, elapsed, inTimeStep);
+	}
+	++m_steps;
+}
+
+void HermiteIntegrator::initialise(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) {
+	const std::size_t count{ inBodies.size() };
+	computeAccelerationsAndJerks(inSolver, inBodies, inBodies.state(), inBodies.accelerations(), m_jerk);
+	m_bodyStep.assign(count, std::numeric_limits<double>::infinity());
+
+	//Without the higher derivatives, the first step comes from the acceleration and jerk alone.
+	const AccelerationBuffer& acc{ inBodies.accelerations() };
+	m_stepSize = inTimeStep;
+	for (std::size_t i = 0; i < count; ++i) {
+		const double a{ length(acc.ax[i], acc.ay[i], acc.az[i]) };
+		const double j{ length(m_jerk.ax[i], m_jerk.ay[i], m_jerk.az[i]) };
+		if (j > 0) m_stepSize = std::min(m_stepSize, m_accuracy * a / j);
+	}
+	m_initialised = true;
+}
+
+void HermiteIntegrator::hermiteStep(BodySystem& inBodies, const ForceSolver& inSolver, double inStepSize) {
+	const std::size_t count{ inBodies.size() };
+	const double dt{ inStepSize };
+	const double dt2{ dt * dt };
+	const double dt3{ dt2 * dt };
+	const BodyState& current{ inBodies.state() };
+	const AccelerationBuffer& acc{ inBodies.accelerations() };
+	BodyState& next{ inBodies.nextState() };
+
+	//Predict the positions and velocities at the end of the step from the Taylor series.
+	m_pool->parallelFor(count, updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		for (std::size_t i = inBegin; i < inEnd; ++i) {
+			next.x[i] = current.x[i] + current.vx[i] * dt + acc.ax[i] * (dt2 / 2) + m_jerk.ax[i] * (dt3 / 6);
+			next.y[i] = current.y[i] + current.vy[i] * dt + acc.ay[i] * (dt2 / 2) + m_jerk.ay[i] * (dt3 / 6);
+			next.z[i] = current.z[i] + current.vz[i] * dt + acc.az[i] * (dt2 / 2) + m_jerk.az[i] * (dt3 / 6);
+			next.vx[i] = current.vx[i] + acc.ax[i] * dt + m_jerk.ax[i] * (dt2 / 2);
+			next.vy[i] = current.vy[i] + acc.ay[i] * dt + m_jerk.ay[i] * (dt2 / 2);
+			next.vz[i] = current.vz[i] + acc.az[i] * dt + m_jerk.az[i] * (dt2 / 2);
+		}
+	});
+
+	computeAccelerationsAndJerks(inSolver, inBodies, next, m_newAcc, m_newJerk);
+
+	//Correct the prediction, overwriting it in place, and work out from the same differences the step each body would like next.
+	m_pool->parallelFor(count, updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		for (std::size_t i = inBegin; i < inEnd; ++i) {
+			const double deltaAX{ acc.ax[i] - m_newAcc.ax[i] };
+			const double deltaAY{ acc.ay[i] - m_newAcc.ay[i] };
+			const double deltaAZ{ acc.az[i] - m_newAcc.az[i] };
+
+			next.vx[i] = current.vx[i] + (acc.ax[i] + m_newAcc.ax[i]) * (dt / 2) + (m_jerk.ax[i] - m_newJerk.ax[i]) * (dt2 / 12);
+			next.vy[i] = current.vy[i] + (acc.ay[i] + m_newAcc.ay[i]) * (dt / 2) + (m_jerk.ay[i] - m_newJerk.ay[i]) * (dt2 / 12);
+			next.vz[i] = current.vz[i] + (acc.az[i] + m_newAcc.az[i]) * (dt / 2) + (m_jerk.az[i] - m_newJerk.az[i]) * (dt2 / 12);
+			next.x[i] = current.x[i] + (current.vx[i] + next.vx[i]) * (dt / 2) + deltaAX * (dt2 / 12);
+			next.y[i] = current.y[i] + (current.vy[i] + next.vy[i]) * (dt / 2) + deltaAY * (dt2 / 12);
+			next.z[i] = current.z[i] + (current.vz[i] + next.vz[i]) * (dt / 2) + deltaAZ * (dt2 / 12);
+
+			//The third derivative of the acceleration, constant across the step, and the second at its end.
+			const double crackleX{ (12 * deltaAX + 6 * dt * (m_jerk.ax[i] + m_newJerk.ax[i])) / dt3 };
+			const double crackleY{ (12 * deltaAY + 6 * dt * (m_jerk.ay[i] + m_newJerk.ay[i])) / dt3 };
+			const double crackleZ{ (12 * deltaAZ + 6 * dt * (m_jerk.az[i] + m_newJerk.az[i])) / dt3 };
+			const double snapX{ (-6 * deltaAX - dt * (4 * m_jerk.ax[i] + 2 * m_newJerk.ax[i])) / dt2 + crackleX * dt };
+			const double snapY{ (-6 * deltaAY - dt * (4 * m_jerk.ay[i] + 2 * m_newJerk.ay[i])) / dt2 + crackleY * dt };
+			const double snapZ{ (-6 * deltaAZ - dt * (4 * m_jerk.az[i] + 2 * m_newJerk.az[i])) / dt2 + crackleZ * dt };
+
+			const double a{ length(m_newAcc.ax[i], m_newAcc.ay[i], m_newAcc.az[i]) };
+			const double j{ length(m_newJerk.ax[i], m_newJerk.ay[i], m_newJerk.az[i]) };
+			const double s{ length(snapX, snapY, snapZ) };
+			const double c{ length(crackleX, crackleY, crackleZ) };
+			const double denominator{ j * c + s * s };
+			m_bodyStep[i] = denominator > 0 ? std::sqrt(m_accuracy * (a * s + j * j) / denominator) : std::numeric_limits<double>::infinity();
+		}
+	});
+
+	inBodies.advanceState();
+	std::swap(inBodies.accelerations(), m_newAcc);
+	std::swap(m_jerk, m_newJerk);
+	++m_hermiteSteps;
+}
+
+void HermiteIntegrator::reset() {
+	m_initialised = false;
+}
+std::string_view HermiteIntegrator::name() const {
+	return "hermite";
+}
+void HermiteIntegrator::printStatistics(std::ostream& outStream) const {
+	Integrator::printStatistics(outStream);
+	outStream << "Hermite steps: " << m_hermiteSteps << '\n';
+}
@@ -0,0 +1,60 @@
+#ifndef Hermite_H
+#define Hermite_H
+
+#include <cstddef>
+
+#include "Integrator.h"
+
+/*
+* The fourth order Hermite predictor-corrector integrator, the workhorse of collisional N-body codes.
+*
+* Each step uses the acceleration a and its rate of change, the jerk j, at both ends of the step. The force solver calculates the two together in one pass
+* (see ForceSolver::computeAccelerationsAndJerks), at little more than the cost of the acceleration alone:
+*
+*	x_p = x + v dt + a dt^2/2 + j dt^3/6							(predict from the start of the step)
+*	v_p = v + a dt + j dt^2/2
+*	a_1, j_1 from x_p and v_p										(the one force evaluation of the step)
+*	v_1 = v + (a + a_1) dt/2 + (j - j_1) dt^2/12					(correct)
+*	x_1 = x + (v + v_1) dt/2 + (a - a_1) dt^2/12
+*
+* This is fourth order with a single force evaluation per step, where a fourth order Runge-Kutta needs four.
+*
+* The differences between the accelerations and jerks at the two ends of the step also give the second and third derivatives of the acceleration,
+* from which the next step is chosen by Aarseth's criterion,
+*
+*	dt = sqrt( eta (|a| |a''| + |j|^2) / (|j| |a'''| + |a''|^2) ),
+*
+* with eta the timestepAccuracy from config.txt. Every body shares the step, which is the shortest any body asks for. It is never longer than the time step
+* in config.txt, and the last step before each output is shortened to land on it exactly. The first step, before anything is known of the higher derivatives,
+* is eta |a| / |j|.
+*
+* Reference: Makino, J. and Aarseth, S. J. (1992). On a Hermite integrator with Ahmad-Cohen scheme for gravitational many-body problems. PASJ 44, 141.
+*/
+
+class HermiteIntegrator : public Integrator
+{
+	double							 m_accuracy{ 0.02 };
+	bool							 m_initialised{ false };
+	double							 m_stepSize{ 0 };				//The step chosen by the criterion after the last one.
+	AccelerationBuffer				 m_jerk;						//The jerks of the current state, to go with the system's accelerations.
+	AccelerationBuffer				 m_newAcc;						//The accelerations and jerks at the predicted state.
+	AccelerationBuffer				 m_newJerk;
+	alignedArray_t<double>			 m_bodyStep;					//The step each body asks for after the last step.
+
+	std::size_t						 m_hermiteSteps{ 0 };			//The internal steps taken, as opposed to the output steps counted by m_steps.
+
+	void initialise(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep);
+	//One predict-evaluate-correct step of length inStepSize, after which m_bodyStep holds each body's next step.
+	void hermiteStep(BodySystem& inBodies, const ForceSolver& inSolver, double inStepSize);
+
+public:
+	explicit HermiteIntegrator(double inAccuracy = 0.02, ThreadPool& inPool = ThreadPool::serial());
+
+	void step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) override;
+	void reset() override;
+	std::string_view name() const override;
+	void printStatistics(std::ostream& outStream) const override;
+};
+
+
+#endif
@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "Hybrid.h"
+
+namespace {
+	//The changeover function K of Chambers (1999) for a pair at separation inR with changeover distance inReach, and its slope dK/dr.
+	//K is 1 inside a tenth of inReach and 0 outside inReach, with a fifth order polynomial between which is smooth to the second derivative.
+	void changeover(double inR, double inReach, double& outK, double& outSlope) {
+		const double y{ (inR - 0.1 * inReach) / (0.9 * inReach) };
+		if (y <= 0) {
+			outK = 1;
+			outSlope = 0;
+		}
+		else if (y >= 1) {
+			outK = 0;
+			outSlope = 0;
+		}
+		else {
+			outK = 1 - y * y * y * (10 - 15 * y + 6 * y * y);
+			outSlope = -30 * y * y * (1 - y) * (1 - y) / (0.9 * inReach);
+		}
+	}
+
+	//The forces inside an encounter group: the central body's pull, which is the Kepler part, and the close part of each pair's pull.
+	//The changeover distances are those of the group's bodies, in the same order.
+	class ChangeoverSolver : public ForceSolver
+	{
+		double						 m_mu;
+		const std::vector<double>*	 m_changeover;
+
+	public:
+		ChangeoverSolver(double inMu, const std::vector<double>& inChangeover) : m_mu{ inMu }, m_changeover{ &inChangeover } {}
+
+		void computeAccelerations(const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc) const override {
+			const std::size_t count{ inState.size() };
+			const alignedArray_t<double>& mass{ inBodies.masses() };
+			outAcc.resize(count);
+			for (std::size_t i = 0; i < count; ++i) {
+				const double r2{ inState.x[i] * inState.x[i] + inState.y[i] * inState.y[i] + inState.z[i] * inState.z[i] };
+				const double factor{ -m_mu / (r2 * std::sqrt(r2)) };
+				outAcc.ax[i] = factor * inState.x[i];
+				outAcc.ay[i] = factor * inState.y[i];
+				outAcc.az[i] = factor * inState.z[i];
+			}
+
+			//The close part of the potential is -G mi mj K(r) / r, whose gradient has a term from the slope of K as well as the usual one.
+			for (std::size_t i = 0; i < count; ++i) {
+				for (std::size_t j = i + 1; j < count; ++j) {
+					const double dx{ inState.x[j] - inState.x[i] };
+					const double dy{ inState.y[j] - inState.y[i] };
+					const double dz{ inState.z[j] - inState.z[i] };
+					const double r2{ dx * dx + dy * dy + dz * dz };
+					const double r{ std::sqrt(r2) };
+					double k, slope;
+					changeover(r, std::max((*m_changeover)[i], (*m_changeover)[j]), k, slope);
+					if (k == 0) continue;
+					const double factor{ BodySystem::G * (k / (r2 * r) - slope / r2) };
+					outAcc.ax[i] += mass[j] * factor * dx;
+					outAcc.ay[i] += mass[j] * factor * dy;
+					outAcc.az[i] += mass[j] * factor * dz;
+					outAcc.ax[j] -= mass[i] * factor * dx;
+					outAcc.ay[j] -= mass[i] * factor * dy;
+					outAcc.az[j] -= mass[i] * factor * dz;
+				}
+			}
+		}
+		std::string_view name() const override {
+			return "changeover";
+		}
+	};
+}
+
+
+HybridIntegrator::HybridIntegrator(double inTolerance, double inChangeoverHillRadii, ThreadPool& inPool) :
+	WisdomHolmanIntegrator{ inPool }, m_changeoverHillRadii{ inChangeoverHillRadii }, m_detector{ 1, inPool }, m_encounterIntegrator{ inTolerance, inPool } {}
+
+void HybridIntegrator::step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) {
+	if (!m_initialised) {
+		initialise(inBodies, inSolver);
+		initialiseChangeover(inTimeStep);
+		removeClosePulls();
+	}
+
+	kick(0.5 * inTimeStep);
+	jump(0.5 * inTimeStep);
+	drift(inTimeStep);
+	jump(0.5 * inTimeStep);
+	computeAccelerations(inSolver, m_planets, m_heliocentric, m_interaction);
+	removeClosePulls();
+	kick(0.5 * inTimeStep);
+
+	for (std::size_t axis = 0; axis < 3; ++axis) m_barycentre[axis] += m_barycentreVelocity[axis] * inTimeStep;
+	writeState(inBodies);
+	++m_steps;
+}
+
+//The changeover distances are fixed from the start, as the split of the Hamiltonian must not change from step to step for the scheme to stay symplectic.
+void HybridIntegrator::initialiseChangeover(double inTimeStep) {
+	const std::size_t count{ m_heliocentric.size() };
+	const alignedArray_t<double>& mass{ m_planets.masses() };
+	m_changeover.assign(count, 0);
+	m_maxChangeover = 0;
+	for (std::size_t i = 0; i < count; ++i) {
+		if (i == m_central) continue;
+		const double r{ std::sqrt(m_heliocentric.x[i] * m_heliocentric.x[i] + m_heliocentric.y[i] * m_heliocentric.y[i] + m_heliocentric.z[i] * m_heliocentric.z[i]) };
+		const double v{ std::sqrt(m_heliocentric.vx[i] * m_heliocentric.vx[i] + m_heliocentric.vy[i] * m_heliocentric.vy[i] + m_heliocentric.vz[i] * m_heliocentric.vz[i]) };
+		const double hillRadius{ r * std::cbrt(mass[i] / (3 * m_centralMass)) };
+		m_changeover[i] = std::max(m_changeoverHillRadii * hillRadius, 0.4 * v * inTimeStep);
+		m_maxChangeover = std::max(m_maxChangeover, m_changeover[i]);
+	}
+	m_group.resize(count);
+}
+
+void HybridIntegrator::removeClosePulls() {
+	if (m_maxChangeover <= 0) return;
+	const alignedArray_t<double>& mass{ m_planets.masses() };
+	m_detector.setRadius(m_maxChangeover);
+	for (const Encounter& pair : m_detector.findEncounters(m_planets, m_heliocentric)) {
+		const std::uint32_t i{ pair.first };
+		const std::uint32_t j{ pair.second };
+		if (i == m_central || j == m_central) continue;
+		double k, slope;
+		changeover(pair.distance, std::max(m_changeover[i], m_changeover[j]), k, slope);
+		if (k == 0 && slope == 0) continue;
+
+		//The solver gave the whole pull, G mj / r^2. Take away the close part, leaving the far part with its own slope term.
+		const double r{ pair.distance };
+		const double dx{ m_heliocentric.x[j] - m_heliocentric.x[i] };
+		const double dy{ m_heliocentric.y[j] - m_heliocentric.y[i] };
+		const double dz{ m_heliocentric.z[j] - m_heliocentric.z[i] };
+		const double factor{ BodySystem::G * (slope / (r * r) - k / (r * r * r)) };
+		m_interaction.ax[i] += mass[j] * factor * dx;
+		m_interaction.ay[i] += mass[j] * factor * dy;
+		m_interaction.az[i] += mass[j] * factor * dz;
+		m_interaction.ax[j] -= mass[i] * factor * dx;
+		m_interaction.ay[j] -= mass[i] * factor * dy;
+		m_interaction.az[j] -= mass[i] * factor * dz;
+	}
+}
+
+std::uint32_t HybridIntegrator::findGroup(std::uint32_t inBody) {
+	while (m_group[inBody] != inBody) {
+		m_group[inBody] = m_group[m_group[inBody]];
+		inBody = m_group[inBody];
+	}
+	return inBody;
+}
+
+void HybridIntegrator::drift(double inTime) {
+	if (m_maxChangeover <= 0) {
+		keplerDrift(inTime);
+		return;
+	}
+
+	//Any pair which could come inside its changeover distance during the step is within this distance at the start of it.
+	const std::size_t count{ m_heliocentric.size() };
+	double fastest2{ 0 };
+	for (std::size_t i = 0; i < count; ++i) {
+		fastest2 = std::max(fastest2, m_heliocentric.vx[i] * m_heliocentric.vx[i] + m_heliocentric.vy[i] * m_heliocentric.vy[i] + m_heliocentric.vz[i] * m_heliocentric.vz[i]);
+	}
+	m_detector.setRadius(m_maxChangeover + 2 * std::sqrt(fastest2) * inTime);
+	m_driftStart = m_heliocentric;
+	const std::vector<Encounter>& candidates{ m_detector.findEncounters(m_planets, m_driftStart) };
+
+	//Everyone takes the Kepler drift, and the ones in encounters are then taken back to the start and drifted again.
+	keplerDrift(inTime);
+
+	//A pair is in an encounter if the straight line through its relative motion at the start, or its Kepler drift, brings it inside its changeover distance.
+	std::iota(m_group.begin(), m_group.end(), 0u);
+	m_closeBodies.clear();
+	for (const Encounter& pair : candidates) {
+		const std::uint32_t i{ pair.first };
+		const std::uint32_t j{ pair.second };
+		if (i == m_central || j == m_central) continue;
+		const double reach{ std::max(m_changeover[i], m_changeover[j]) };
+
+		const double dx{ m_driftStart.x[j] - m_driftStart.x[i] };
+		const double dy{ m_driftStart.y[j] - m_driftStart.y[i] };
+		const double dz{ m_driftStart.z[j] - m_driftStart.z[i] };
+		const double dvx{ m_driftStart.vx[j] - m_driftStart.vx[i] };
+		const double dvy{ m_driftStart.vy[j] - m_driftStart.vy[i] };
+		const double dvz{ m_driftStart.vz[j] - m_driftStart.vz[i] };
+		const double dv2{ dvx * dvx + dvy * dvy + dvz * dvz };
+		const double closestTime{ dv2 > 0 ? std::clamp(-(dx * dvx + dy * dvy + dz * dvz) / dv2, 0.0, inTime) : 0.0 };
+		const double cx{ dx + dvx * closestTime };
+		const double cy{ dy + dvy * closestTime };
+		const double cz{ dz + dvz * closestTime };
+
+		const double ex{ m_heliocentric.x[j] - m_heliocentric.x[i] };
+		const double ey{ m_heliocentric.y[j] - m_heliocentric.y[i] };
+		const double ez{ m_heliocentric.z[j] - m_heliocentric.z[i] };
+		const double closest2{ std::min(cx * cx + cy * cy + cz * cz, ex * ex + ey * ey + ez * ez) };
+		if (closest2 >= reach * reach) continue;
+
+		m_group[findGroup(i)] = findGroup(j);
+		m_closeBodies.push_back(i);
+		m_closeBodies.push_back(j);
+	}
+	if (m_closeBodies.empty()) return;
+
+	//Sort the bodies in encounters by group, and drift each group in turn.
+	std::sort(m_closeBodies.begin(), m_closeBodies.end());
+	m_closeBodies.erase(std::unique(m_closeBodies.begin(), m_closeBodies.end()), m_closeBodies.end());
+	std::stable_sort(m_closeBodies.begin(), m_closeBodies.end(), [this](std::uint32_t a, std::uint32_t b) { return findGroup(a) < findGroup(b); });
+	std::vector<std::uint32_t> members;
+	for (std::size_t first = 0; first < m_closeBodies.size();) {
+		std::size_t last{ first };
+		while (last < m_closeBodies.size() && findGroup(m_closeBodies[last]) == findGroup(m_closeBodies[first])) ++last;
+		members.assign(m_closeBodies.begin() + first, m_closeBodies.begin() + last);
+		driftGroup(members, inTime);
+		first = last;
+	}
+}
+
+void HybridIntegrator::driftGroup(const std::vector<std::uint32_t>& inMembers, double inTime) {
+	const alignedArray_t<double>& mass{ m_planets.masses() };
+	const std::vector<std::string>& names{ m_planets.names() };
+
+	//Massive bodies first, which is where addBody puts them, so that body k of the group is m_encounterMembers[k].
+	m_encounterMembers.clear();
+	for (const std::uint32_t i : inMembers) {
+		if (mass[i] > 0) m_encounterMembers.push_back(i);
+	}
+	for (const std::uint32_t i : inMembers) {
+		if (mass[i] == 0) m_encounterMembers.push_back(i);
+	}
+
+	m_encounterBodies = BodySystem{};
+	m_encounterBodies.reserve(m_encounterMembers.size());
+	m_encounterChangeover.clear();
+	for (const std::uint32_t i : m_encounterMembers) {
+		m_encounterBodies.addBody(names[i], mass[i], { m_driftStart.x[i], m_driftStart.y[i], m_driftStart.z[i] }, { m_driftStart.vx[i], m_driftStart.vy[i], m_driftStart.vz[i] });
+		m_encounterChangeover.push_back(m_changeover[i]);
+	}
+
+	const ChangeoverSolver solver{ BodySystem::G * m_centralMass, m_encounterChangeover };
+	m_encounterIntegrator.reset();
+	m_encounterIntegrator.step(m_encounterBodies, solver, inTime);
+
+	const BodyState& state{ m_encounterBodies.state() };
+	for (std::size_t k = 0; k < m_encounterMembers.size(); ++k) {
+		const std::uint32_t i{ m_encounterMembers[k] };
+		m_heliocentric.x[i] = state.x[k];
+		m_heliocentric.y[i] = state.y[k];
+		m_heliocentric.z[i] = state.z[k];
+		m_heliocentric.vx[i] = state.vx[k];
+		m_heliocentric.vy[i] = state.vy[k];
+		m_heliocentric.vz[i] = state.vz[k];
+	}
+	++m_encounterDrifts;
+	m_encounterBodyCount += m_encounterMembers.size();
+}
+
+std::string_view HybridIntegrator::name() const {
+	return "hybrid";
+}
+void HybridIntegrator::printStatistics(std::ostream& outStream) const {
+	Integrator::printStatistics(outStream);
+	outStream << "Encounter drifts: " << m_encounterDrifts << '\t' << "Bodies drifted in them: " << m_encounterBodyCount << '\n';
+	if (m_encounterDrifts > 0) {
+		outStream << "Within encounters:\n";
+		m_encounterIntegrator.printStatistics(outStream);
+	}
+}
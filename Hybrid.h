@@ -0,0 +1,74 @@
+#ifndef Hybrid_H
+#define Hybrid_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "WisdomHolman.h"
+#include "BulirschStoer.h"
+#include "Encounters.h"
+
+/*
+* A hybrid symplectic integrator in the style of Chambers' MERCURY, which takes Wisdom-Holman steps almost all of the time and hands the bodies in a close
+* encounter to the Bulirsch-Stoer integrator until it is over.
+*
+* Wisdom-Holman treats the planets' pulls on each other as a small kick twice a step. When two planets pass close to each other that pull is no longer small,
+* and the step would have to shrink to the length of the encounter for the whole system. Instead, the pull between each pair is split into a close part and
+* a far part with a smooth changeover function K(r), which is 1 when the pair is close, 0 when it is far, and changes smoothly over the changeover distance:
+*
+*	close part		-G mi mj K(r) / r			moved into the Kepler part of the Hamiltonian
+*	far part		-G mi mj (1 - K(r)) / r		left in the interaction kicks
+*
+* For pairs well apart K is zero and the step is exactly the Wisdom-Holman one. A pair inside its changeover distance, or which could come inside it during the
+* step, is drifted together with the Bulirsch-Stoer integrator under the central body's pull and its close part, while everything else follows its Kepler
+* orbit as usual. Bodies linked by such pairs are drifted as one group, so a planet meeting two others at once is handled correctly. The far parts of the
+* pulls are always smooth, so the kicks stay accurate with the usual long steps, and the whole scheme stays symplectic apart from the tolerance of the
+* Bulirsch-Stoer drifts.
+*
+* The changeover distance of a pair is the larger of the two bodies' own. A body's own is changeoverRadius Hill radii, or 0.4 of the distance it moves in one step
+* if that is larger, both worked out when the integrator starts. K goes from 1 at a tenth of the changeover distance to 0 at the changeover distance.
+* Candidate pairs are found with the spatial hash of the close encounter detector (see Encounters.h), so the cost stays near that of Wisdom-Holman
+* for large systems.
+*
+* As with Wisdom-Holman, the most massive body is the central one, and its encounters with other bodies are not treated specially. The close parts are
+* unsoftened, so the force solver should be too.
+*
+* Reference: Chambers, J. E. (1999). A hybrid symplectic integrator that permits close encounters between massive bodies. MNRAS 304, 793.
+*/
+
+class HybridIntegrator : public WisdomHolmanIntegrator
+{
+	double							 m_changeoverHillRadii{ 3 };
+	std::vector<double>				 m_changeover;					//The changeover distance of each body.
+	double							 m_maxChangeover{ 0 };
+	EncounterDetector				 m_detector;
+	BodyState						 m_driftStart;					//The heliocentric state at the start of the drift, for the bodies handed to Bulirsch-Stoer.
+	std::vector<std::uint32_t>		 m_group;						//For joining the close pairs into groups: each body points to another in its group, and the last to itself.
+	std::vector<std::uint32_t>		 m_closeBodies;
+
+	BulirschStoerIntegrator			 m_encounterIntegrator;
+	BodySystem						 m_encounterBodies;				//The bodies of the group being drifted, in heliocentric coordinates.
+	std::vector<std::uint32_t>		 m_encounterMembers;			//Which body each of those is.
+	std::vector<double>				 m_encounterChangeover;
+	std::size_t						 m_encounterDrifts{ 0 };		//The number of group drifts, and the bodies in them, for the statistics.
+	std::size_t						 m_encounterBodyCount{ 0 };
+
+	void initialiseChangeover(double inTimeStep);
+	//Take the close parts of the pairs inside their changeover distance out of the interaction accelerations.
+	void removeClosePulls();
+	//Kepler drift for the bodies out of any encounter, and a Bulirsch-Stoer drift of each group in one.
+	void drift(double inTime);
+	std::uint32_t findGroup(std::uint32_t inBody);
+	void driftGroup(const std::vector<std::uint32_t>& inMembers, double inTime);
+
+public:
+	explicit HybridIntegrator(double inTolerance = 1e-10, double inChangeoverHillRadii = 3, ThreadPool& inPool = ThreadPool::serial());
+
+	void step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) override;
+	std::string_view name() const override;
+	void printStatistics(std::ostream& outStream) const override;
+};
+
+
+#endif
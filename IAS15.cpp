@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "IAS15.h"
+
+namespace {
+
+constexpr std::size_t order{ IAS15Integrator::order };
+
+//The Gauss-Radau spacings: the start of the step and the seven points within it at which the forces are evaluated, as fractions of the step.
+constexpr double spacings[order + 1]{ 0.0, 0.0562625605369221464656521910318, 0.180240691736892364987579942780, 0.352624717113169637373907769648,
+	0.547153626330555383001448554766, 0.734210177215410531523210605558, 0.885320946839095768090359771030, 0.977520613561287501891174488626 };
+
+//The acceleration polynomial is held in two forms. The power form is a0 + b0 h + b1 h^2 + ..., and the Newton form is a0 + g0 N0(h) + g1 N1(h) + ...,
+//with N_n(h) = h (h - h_1) ... (h - h_n) for the spacings h_k. The Newton form can be updated one point at a time, and the power form integrated,
+//so the two are converted back and forth using these tables.
+struct ConversionTables {
+	double newtonToPower[order][order]{};						//[n][k]: the coefficient of h^(k+1) in N_n(h).
+	double powerToNewton[order][order]{};						//[k][n]: the coefficient of N_n(h) in h^(k+1).
+	double shift[order][order]{};								//[k][j]: the binomial coefficient C(j+1, k+1), for moving the polynomial of one step onto the next.
+};
+constexpr ConversionTables makeConversionTables() {
+	ConversionTables tables;
+	//N_0 = h, and N_n = N_(n-1) (h - h_n).
+	tables.newtonToPower[0][0] = 1;
+	for (std::size_t n = 1; n < order; ++n) {
+		for (std::size_t k = 0; k <= n; ++k) {
+			tables.newtonToPower[n][k] = (k > 0 ? tables.newtonToPower[n - 1][k - 1] : 0) - spacings[n] * tables.newtonToPower[n - 1][k];
+		}
+	}
+	//h^1 = N_0, and h N_n = N_(n+1) + h_(n+1) N_n, so each power follows from the one below.
+	tables.powerToNewton[0][0] = 1;
+	for (std::size_t k = 1; k < order; ++k) {
+		for (std::size_t n = 0; n <= k; ++n) {
+			tables.powerToNewton[k][n] = (n > 0 ? tables.powerToNewton[k - 1][n - 1] : 0) + (n < k ? spacings[n + 1] * tables.powerToNewton[k - 1][n] : 0);
+		}
+	}
+	//Pascal's triangle, with C(j+1, k+1) = C(j, k) + C(j, k+1).
+	for (std::size_t j = 0; j < order; ++j) {
+		tables.shift[0][j] = static_cast<double>(j + 1);
+		for (std::size_t k = 1; k <= j; ++k) tables.shift[k][j] = tables.shift[k - 1][j - 1] + (k < j ? tables.shift[k][j - 1] : 0);
+	}
+	return tables;
+}
+constexpr ConversionTables conversion{ makeConversionTables() };
+
+constexpr double epsilon{ 1e-9 };								//The target size of |b6| / |a|.
+constexpr double safetyFactor{ 0.25 };							//Steps may grow by at most 1 / safetyFactor, and are rejected if they need to shrink by more.
+constexpr std::size_t maxIterations{ 12 };
+constexpr double convergedError{ 1e-16 };
+
+constexpr std::size_t updateGrain{ 4096 };
+
+alignedArray_t<double>& component(AccelerationBuffer& inBuffer, std::size_t inAxis) {
+	return inAxis == 0 ? inBuffer.ax : inAxis == 1 ? inBuffer.ay : inBuffer.az;
+}
+alignedArray_t<double>& position(BodyState& inState, std::size_t inAxis) {
+	return inAxis == 0 ? inState.x : inAxis == 1 ? inState.y : inState.z;
+}
+alignedArray_t<double>& velocity(BodyState& inState, std::size_t inAxis) {
+	return inAxis == 0 ? inState.vx : inAxis == 1 ? inState.vy : inState.vz;
+}
+
+double largestMagnitude(const AccelerationBuffer& inBuffer) {
+	double largest{ 0 };
+	for (std::size_t i = 0; i < inBuffer.size(); ++i) {
+		largest = std::max({ largest, std::abs(inBuffer.ax[i]), std::abs(inBuffer.ay[i]), std::abs(inBuffer.az[i]) });
+	}
+	return largest;
+}
+
+//Kahan summation: add inValue to ioSum, carrying the rounding error in ioCompensation to be taken off the next addition.
+void compensatedAdd(double& ioSum, double& ioCompensation, double inValue) {
+	const double corrected{ inValue - ioCompensation };
+	const double sum{ ioSum + corrected };
+	ioCompensation = (sum - ioSum) - corrected;
+	ioSum = sum;
+}
+
+}
+
+
+IAS15Integrator::IAS15Integrator(ThreadPool& inPool) : Integrator{ inPool } {}
+
+void IAS15Integrator::step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) {
+	if (!m_initialised) {
+		initialise(inBodies);
+		m_stepSize = inTimeStep;
+	}
+
+	//Take steps of the size the controller asks for until the next would reach the output time, then one to land on it.
+	double elapsed{ 0 };
+	bool finished{ false };
+	while (!finished) {
+		double stepSize{ m_stepSize };
+		finished = elapsed + stepSize >= inTimeStep;
+		if (finished) stepSize = inTimeStep - elapsed;
+		if (attemptStep(inBodies, inSolver, stepSize)) elapsed += stepSize;
+		else finished = false;
+		checkStepSize(m_stepSize, elapsed, inTimeStep);
+	}
+	++m_steps;
+}
+
+void IAS15Integrator::initialise(const BodySystem& inBodies) {
+	const std::size_t count{ inBodies.size() };
+	for (std::size_t k = 0; k < order; ++k) {
+		m_b[k].resize(count);
+		m_g[k].resize(count);
+		m_lastB[k].resize(count);
+		m_lastPrediction[k].resize(count);
+		m_prediction[k].resize(count);
+	}
+	m_substep.resize(count);
+	m_lastChange.resize(count);
+	m_compensation.resize(count);
+	std::fill(m_compensation.x.begin(), m_compensation.x.end(), 0.0);
+	std::fill(m_compensation.y.begin(), m_compensation.y.end(), 0.0);
+	std::fill(m_compensation.z.begin(), m_compensation.z.end(), 0.0);
+	std::fill(m_compensation.vx.begin(), m_compensation.vx.end(), 0.0);
+	std::fill(m_compensation.vy.begin(), m_compensation.vy.end(), 0.0);
+	std::fill(m_compensation.vz.begin(), m_compensation.vz.end(), 0.0);
+	m_lastStepSize = 0;
+	m_haveStartAcc = false;
+	m_initialised = true;
+}
+
+//With q the ratio of the new step to the old, the old polynomial shifted to the new step has coefficients e_k = q^(k+1) Sum_(j>=k) C(j+1, k+1) b_j.
+//The difference between the last step's prediction and the coefficients it converged to is added on as well, as it tends to repeat from step to step.
+void IAS15Integrator::predictCoefficients(double inStepSize) {
+	const double ratio{ m_lastStepSize > 0 ? inStepSize / m_lastStepSize : 0 };
+	//With nothing to go on, or a step so much longer than the last that the old polynomial is no guide, start from zero.
+	const bool usable{ ratio > 0 && ratio <= 20 };
+
+	double scale[order];
+	double power{ ratio };
+	for (std::size_t k = 0; k < order; ++k) {
+		scale[k] = power;
+		power *= ratio;
+	}
+
+	m_pool->parallelFor(m_b[0].size(), updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		for (std::size_t axis = 0; axis < 3; ++axis) {
+			for (std::size_t i = inBegin; i < inEnd; ++i) {
+				for (std::size_t k = 0; k < order; ++k) {
+					double predicted{ 0 };
+					double correction{ 0 };
+					if (usable) {
+						for (std::size_t j = k; j < order; ++j) predicted += conversion.shift[k][j] * component(m_lastB[j], axis)[i];
+						predicted *= scale[k];
+						correction = component(m_lastB[k], axis)[i] - component(m_lastPrediction[k], axis)[i];
+					}
+					component(m_prediction[k], axis)[i] = predicted;
+					component(m_b[k], axis)[i] = predicted + correction;
+				}
+				for (std::size_t n = 0; n < order; ++n) {
+					double g{ 0 };
+					for (std::size_t k = n; k < order; ++k) g += conversion.powerToNewton[k][n] * component(m_b[k], axis)[i];
+					component(m_g[n], axis)[i] = g;
+				}
+			}
+		}
+	});
+}
+
+bool IAS15Integrator::attemptStep(BodySystem& inBodies, const ForceSolver& inSolver, double inStepSize) {
+	const std::size_t count{ inBodies.size() };
+	const double dt{ inStepSize };
+	BodyState& state{ inBodies.state() };
+
+	if (!m_haveStartAcc) {
+		computeAccelerations(inSolver, inBodies, state, m_startAcc);
+		m_haveStartAcc = true;
+	}
+	predictCoefficients(dt);
+
+	//The predictor-corrector loop. Each pass moves through the seven points in turn, evaluating the forces there from the current polynomial
+	//and updating the polynomial to match. It stops once the last coefficient no longer changes, or stops improving.
+	double lastError{ 2 };
+	for (std::size_t iteration = 0; iteration < maxIterations; ++iteration) {
+		for (std::size_t n = 1; n <= order; ++n) {
+			const double h{ spacings[n] };
+			const double hdt{ h * dt };
+			double weight[order];
+			double power{ h };
+			for (std::size_t k = 0; k < order; ++k) {
+				weight[k] = hdt * hdt * power / static_cast<double>((k + 2) * (k + 3));
+				power *= h;
+			}
+
+			m_pool->parallelFor(count, updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+				for (std::size_t axis = 0; axis < 3; ++axis) {
+					const alignedArray_t<double>& x0{ position(state, axis) };
+					const alignedArray_t<double>& v0{ velocity(state, axis) };
+					const alignedArray_t<double>& a0{ component(m_startAcc, axis) };
+					const alignedArray_t<double>& xCompensation{ position(m_compensation, axis) };
+					alignedArray_t<double>& x{ position(m_substep, axis) };
+					for (std::size_t i = inBegin; i < inEnd; ++i) {
+						double polynomial{ 0 };
+						for (std::size_t k = order; k-- > 0;) polynomial += weight[k] * component(m_b[k], axis)[i];
+						x[i] = x0[i] - xCompensation[i] + (hdt * v0[i] + (0.5 * hdt * hdt * a0[i] + polynomial));
+					}
+				}
+			});
+
+			computeAccelerations(inSolver, inBodies, m_substep, m_substepAcc);
+
+			//The new Newton coefficient g_(n-1) is the divided difference of the accelerations at this point and those before it.
+			//Its change is then folded into every power coefficient it contributes to.
+			m_pool->parallelFor(count, updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+				for (std::size_t axis = 0; axis < 3; ++axis) {
+					const alignedArray_t<double>& a0{ component(m_startAcc, axis) };
+					const alignedArray_t<double>& a{ component(m_substepAcc, axis) };
+					alignedArray_t<double>& g{ component(m_g[n - 1], axis) };
+					for (std::size_t i = inBegin; i < inEnd; ++i) {
+						double difference{ a[i] - a0[i] };
+						for (std::size_t j = 0; j < n; ++j) {
+							difference /= h - spacings[j];
+							if (j + 1 < n) difference -= component(m_g[j], axis)[i];
+						}
+						const double change{ difference - g[i] };
+						g[i] = difference;
+						for (std::size_t k = 0; k < n; ++k) component(m_b[k], axis)[i] += change * conversion.newtonToPower[n - 1][k];
+						if (n == order) component(m_lastChange, axis)[i] = change;
+					}
+				}
+			});
+		}
+		++m_iterations;
+
+		const double error{ largestMagnitude(m_lastChange) / largestMagnitude(m_substepAcc) };
+		if (!(error >= convergedError)) break;
+		if (iteration >= 2 && error >= lastError) break;
+		lastError = error;
+	}
+
+	//Choose the next step from the size of the last coefficient, and reject this one if the next needs to be much shorter.
+	const double fitError{ largestMagnitude(m_b[order - 1]) / largestMagnitude(m_substepAcc) };
+	double nextStep{ std::isnormal(fitError) ? dt * std::pow(epsilon / fitError, 1.0 / 7) : dt / safetyFactor };
+	if (nextStep < safetyFactor * dt) {
+		m_stepSize = nextStep;
+		++m_rejectedSteps;
+		return false;
+	}
+	//A step cut short to land on an output time is no guide to how long the next can be, so growth is measured from the longer of the two.
+	m_stepSize = std::min(nextStep, std::max(dt, m_stepSize) / safetyFactor);
+
+	//Integrate the polynomial over the whole step, twice, and add the change to the positions and velocities.
+	double positionWeight[order];
+	double velocityWeight[order];
+	for (std::size_t k = 0; k < order; ++k) {
+		positionWeight[k] = dt * dt / static_cast<double>((k + 2) * (k + 3));
+		velocityWeight[k] = dt / static_cast<double>(k + 2);
+	}
+	m_pool->parallelFor(count, updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		for (std::size_t axis = 0; axis < 3; ++axis) {
+			alignedArray_t<double>& x{ position(state, axis) };
+			alignedArray_t<double>& v{ velocity(state, axis) };
+			alignedArray_t<double>& xCompensation{ position(m_compensation, axis) };
+			alignedArray_t<double>& vCompensation{ velocity(m_compensation, axis) };
+			const alignedArray_t<double>& a0{ component(m_startAcc, axis) };
+			for (std::size_t i = inBegin; i < inEnd; ++i) {
+				double positionChange{ 0 };
+				double velocityChange{ 0 };
+				for (std::size_t k = order; k-- > 0;) {
+					positionChange += positionWeight[k] * component(m_b[k], axis)[i];
+					velocityChange += velocityWeight[k] * component(m_b[k], axis)[i];
+				}
+				compensatedAdd(x[i], xCompensation[i], dt * v[i] + (0.5 * dt * dt * a0[i] + positionChange));
+				compensatedAdd(v[i], vCompensation[i], dt * a0[i] + velocityChange);
+			}
+		}
+	});
+
+	std::swap(m_lastB, m_b);
+	std::swap(m_lastPrediction, m_prediction);
+	m_lastStepSize = dt;
+	computeAccelerations(inSolver, inBodies, state, m_startAcc);
+	++m_acceptedSteps;
+	return true;
+}
+
+void IAS15Integrator::reset() {
+	m_initialised = false;
+}
+std::string_view IAS15Integrator::name() const {
+	return "ias15";
+}
+void IAS15Integrator::printStatistics(std::ostream& outStream) const {
+	Integrator::printStatistics(outStream);
+	const std::size_t attempts{ m_acceptedSteps + m_rejectedSteps };
+	outStream << "Internal steps accepted: " << m_acceptedSteps << '\t' << "Rejected: " << m_rejectedSteps;
+	if (attempts > 0) outStream << " (" << 100.0 * static_cast<double>(m_rejectedSteps) / static_cast<double>(attempts) << "%)";
+	outStream << '\t' << "Predictor-corrector iterations per step: " << (attempts > 0 ? static_cast<double>(m_iterations) / static_cast<double>(attempts) : 0) << '\n';
+}
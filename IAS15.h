@@ -0,0 +1,75 @@
+#ifndef IAS15_H
+#define IAS15_H
+
+#include <array>
+#include <cstddef>
+
+#include "Integrator.h"
+
+/*
+* IAS15, a fifteenth order adaptive integrator built on Gauss-Radau quadrature, for reference runs accurate to the limit of double precision.
+*
+* Over each step the acceleration of every body is written as a polynomial in the fraction h of the step taken so far,
+*
+*	a(h) = a0 + b0 h + b1 h^2 + ... + b6 h^7,
+*
+* which is integrated twice, exactly, to give the position and velocity at any point in the step. The coefficients b are found by evaluating the forces at the
+* seven Gauss-Radau points within the step and iterating until they stop changing (a predictor-corrector loop). The coefficients from the last step,
+* rescaled to the new step length, are a good first guess, so two iterations are usually enough: 15 force evaluations a step, for fifteenth order.
+*
+* The last coefficient, b6, is a direct measure of how well the polynomial fits. The next step is chosen so that |b6| / |a| stays at epsilon = 1e-9,
+* which in practice keeps the error of each step below the rounding error. A step which turns out to need to be more than four times shorter is rejected and retried.
+* The positions and velocities are accumulated with compensated (Kahan) summation, so the rounding error of adding a small change to a large position
+* does not build up either. The energy error then grows only as a random walk of rounding errors, rather than steadily.
+*
+* Steps are chosen internally. Each call to step() takes as many as needed to reach the next output time, shortening the last one to land on it exactly.
+*
+* Reference: Rein, H. and Spiegel, D. S. (2015). IAS15: a fast, adaptive, high-order integrator for gravitational dynamics, accurate to machine precision
+* over a billion orbits. MNRAS 446, 1424. Based on Everhart, E. (1985). An efficient integrator that uses Gauss-Radau spacings.
+*/
+
+class IAS15Integrator : public Integrator
+{
+public:
+	static constexpr std::size_t order{ 7 };						//The number of coefficients b, one per Gauss-Radau point after the start of the step.
+
+private:
+	using coefficients_t = std::array<AccelerationBuffer, order>;
+
+	bool							 m_initialised{ false };
+	double							 m_stepSize{ 0 };				//The length of the next step, as chosen by the controller.
+	double							 m_lastStepSize{ 0 };			//The length of the last accepted step, zero before the first.
+	bool							 m_haveStartAcc{ false };
+
+	coefficients_t					 m_b;							//The coefficients of the acceleration polynomial over the step being taken...
+	coefficients_t					 m_g;							//...the same polynomial in the Newton form which the substeps update...
+	coefficients_t					 m_lastB;						//...the coefficients of the last accepted step...
+	coefficients_t					 m_lastPrediction;				//...and the prediction it started from, used to correct the next prediction.
+	coefficients_t					 m_prediction;
+	AccelerationBuffer				 m_startAcc;					//The accelerations at the start of the step.
+	AccelerationBuffer				 m_substepAcc;
+	BodyState						 m_substep;						//The positions at one of the Gauss-Radau points.
+	BodyState						 m_compensation;				//The rounding error carried by the compensated sums of the positions and velocities.
+	AccelerationBuffer				 m_lastChange;					//The change in the last coefficient during the latest iteration, for the convergence test.
+
+	std::size_t						 m_acceptedSteps{ 0 };
+	std::size_t						 m_rejectedSteps{ 0 };
+	std::size_t						 m_iterations{ 0 };
+
+	void initialise(const BodySystem& inBodies);
+	//Try one step of length inStepSize. Returns whether it was accepted. Either way, m_stepSize is left holding the next step to try.
+	bool attemptStep(BodySystem& inBodies, const ForceSolver& inSolver, double inStepSize);
+	//Rescale the coefficients of the last accepted step to a step of a different length, as the first guess for the next.
+	void predictCoefficients(double inStepSize);
+
+public:
+	explicit IAS15Integrator(ThreadPool& inPool = ThreadPool::serial());
+
+	void step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) override;
+	void reset() override;
+	std::string_view name() const override;
+	void printStatistics(std::ostream& outStream) const override;
+};
+
+
+#endif
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "Integrator.h"
+#include "CompositionIntegrator.h"
+#include "DormandPrince.h"
+#include "BlockTimestep.h"
+#include "Hermite.h"
+#include "WisdomHolman.h"
+#include "Hybrid.h"
+#include "IAS15.h"
+#include "BulirschStoer.h"
+
+namespace {
+	//The update loops do very little work per body, so blocks are kept large and small systems are updated on one thread.
+	constexpr std::size_t updateGrain{ 4096 };
+}
+
+
+//Base class
+Integrator::Integrator(ThreadPool& inPool) : m_pool{ &inPool } {}
+
+void Integrator::computeAccelerations(const ForceSolver& inSolver, const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc) {
+	inSolver.computeAccelerations(inBodies, inState, outAcc);
+	++m_forceEvaluations;
+}
+void Integrator::computeAccelerations(const ForceSolver& inSolver, BodySystem& inBodies) {
+	computeAccelerations(inSolver, inBodies, inBodies.state(), inBodies.accelerations());
+}
+void Integrator::computeSubsetAccelerations(const ForceSolver& inSolver, const BodySystem& inBodies, const BodyState& inState, const std::vector<std::uint32_t>& inTargets, AccelerationBuffer& outAcc) {
+	inSolver.computeSubsetAccelerations(inBodies, inState, inTargets, outAcc);
+	++m_forceEvaluations;
+}
+void Integrator::computeAccelerationsAndJerks(const ForceSolver& inSolver, const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc, AccelerationBuffer& outJerk) {
+	inSolver.computeAccelerationsAndJerks(inBodies, inState, outAcc, outJerk);
+	++m_forceEvaluations;
+}
+
+void Integrator::checkStepSize(double inStepSize, double inTime, double inOutputStep) const {
+	const double minimum{ std::max(minimumStepFraction * inOutputStep, 4 * std::numeric_limits<double>::epsilon() * std::abs(inTime)) };
+	//Written this way round so that a NaN step fails too.
+	if (inStepSize >= minimum) return;
+	std::cerr << "The " << name() << " integrator asked for a step of " << inStepSize << " s, shorter than the shortest allowed (" << minimum
+		<< " s). The positions or velocities may have become NaN or infinite, or two bodies may have collided.\n";
+	throw std::runtime_error("Error: integrator step size fell below the minimum");
+}
+
+void Integrator::reset() {}
+
+void Integrator::printStatistics(std::ostream& outStream) const {
+	outStream << "Integrator: " << name() << '\t' << "Steps: " << m_steps << '\t' << "Force evaluations: " << m_forceEvaluations << '\n';
+}
+
+
+//Euler
+EulerIntegrator::EulerIntegrator(ThreadPool& inPool) : Integrator{ inPool } {}
+
+void EulerIntegrator::step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) {
+	computeAccelerations(inSolver, inBodies);
+	const BodyState& current{ inBodies.state() };
+	const AccelerationBuffer& acc{ inBodies.accelerations() };
+	BodyState& next{ inBodies.nextState() };
+
+	m_pool->parallelFor(inBodies.size(), updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		for (std::size_t i = inBegin; i < inEnd; ++i) {
+			next.x[i] = current.x[i] + current.vx[i] * inTimeStep;
+			next.y[i] = current.y[i] + current.vy[i] * inTimeStep;
+			next.z[i] = current.z[i] + current.vz[i] * inTimeStep;
+			next.vx[i] = current.vx[i] + acc.ax[i] * inTimeStep;
+			next.vy[i] = current.vy[i] + acc.ay[i] * inTimeStep;
+			next.vz[i] = current.vz[i] + acc.az[i] * inTimeStep;
+		}
+	});
+	inBodies.advanceState();
+	++m_steps;
+}
+std::string_view EulerIntegrator::name() const {
+	return "euler";
+}
+
+
+//Euler-Cromer. As with Planet, velocity is updated first so that the position update uses the (n+1)th velocity.
+EulerCromerIntegrator::EulerCromerIntegrator(ThreadPool& inPool) : Integrator{ inPool } {}
+
+void EulerCromerIntegrator::step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) {
+	//Phase one reads the current state only. Phase two reads the current state and writes only the next one.
+	computeAccelerations(inSolver, inBodies);
+	const BodyState& current{ inBodies.state() };
+	const AccelerationBuffer& acc{ inBodies.accelerations() };
+	BodyState& next{ inBodies.nextState() };
+
+	m_pool->parallelFor(inBodies.size(), updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		for (std::size_t i = inBegin; i < inEnd; ++i) {
+			next.vx[i] = current.vx[i] + acc.ax[i] * inTimeStep;
+			next.vy[i] = current.vy[i] + acc.ay[i] * inTimeStep;
+			next.vz[i] = current.vz[i] + acc.az[i] * inTimeStep;
+			next.x[i] = current.x[i] + next.vx[i] * inTimeStep;
+			next.y[i] = current.y[i] + next.vy[i] * inTimeStep;
+			next.z[i] = current.z[i] + next.vz[i] * inTimeStep;
+		}
+	});
+	inBodies.advanceState();
+	++m_steps;
+}
+std::string_view EulerCromerIntegrator::name() const {
+	return "eulerCromer";
+}
+
+
+//Leapfrog
+LeapfrogIntegrator::LeapfrogIntegrator(ThreadPool& inPool) : Integrator{ inPool } {}
+
+void LeapfrogIntegrator::step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) {
+	kickDriftKick(inBodies, inSolver, inTimeStep);
+	++m_steps;
+}
+void LeapfrogIntegrator::kickDriftKick(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) {
+	const double halfStep{ 0.5 * inTimeStep };
+
+	//Only the very first step (or the first after a reset) has to work out the accelerations at the start.
+	if (!m_haveAccelerations) computeAccelerations(inSolver, inBodies);
+
+	//Kick and drift, from the current state into the next.
+	{
+		const BodyState& current{ inBodies.state() };
+		const AccelerationBuffer& acc{ inBodies.accelerations() };
+		BodyState& next{ inBodies.nextState() };
+		m_pool->parallelFor(inBodies.size(), updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+			for (std::size_t i = inBegin; i < inEnd; ++i) {
+				next.vx[i] = current.vx[i] + acc.ax[i] * halfStep;
+				next.vy[i] = current.vy[i] + acc.ay[i] * halfStep;
+				next.vz[i] = current.vz[i] + acc.az[i] * halfStep;
+				next.x[i] = current.x[i] + next.vx[i] * inTimeStep;
+				next.y[i] = current.y[i] + next.vy[i] * inTimeStep;
+				next.z[i] = current.z[i] + next.vz[i] * inTimeStep;
+			}
+		});
+		inBodies.advanceState();
+	}
+
+	//The accelerations at the new positions, which finish this step and start the next.
+	computeAccelerations(inSolver, inBodies);
+	m_haveAccelerations = true;
+
+	//The closing kick only reads and writes each body's own entries, so it can be done in place.
+	BodyState& state{ inBodies.state() };
+	const AccelerationBuffer& acc{ inBodies.accelerations() };
+	m_pool->parallelFor(inBodies.size(), updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		for (std::size_t i = inBegin; i < inEnd; ++i) {
+			state.vx[i] += acc.ax[i] * halfStep;
+			state.vy[i] += acc.ay[i] * halfStep;
+			state.vz[i] += acc.az[i] * halfStep;
+		}
+	});
+}
+void LeapfrogIntegrator::reset() {
+	m_haveAccelerations = false;
+}
+std::string_view LeapfrogIntegrator::name() const {
+	return "leapfrog";
+}
+
+
+std::unique_ptr<Integrator> makeIntegrator(const SimulationSettings& inSettings, ThreadPool& inPool) {
+	const std::string& name{ inSettings.integrator };
+	if (name == "euler") return std::make_unique<EulerIntegrator>(inPool);
+	if (name == "eulerCromer") return std::make_unique<EulerCromerIntegrator>(inPool);
+	if (name == "leapfrog") return std::make_unique<LeapfrogIntegrator>(inPool);
+	if (name == "yoshida4") return std::make_unique<Yoshida4Integrator>(inPool);
+	if (name == "suzuki4") return std::make_unique<Suzuki4Integrator>(inPool);
+	if (name == "yoshida6") return std::make_unique<Yoshida6Integrator>(inPool);
+	if (name == "kahanLi6") return std::make_unique<KahanLi6Integrator>(inPool);
+	if (name == "yoshida8") return std::make_unique<Yoshida8Integrator>(inPool);
+	if (name == "kahanLi8") return std::make_unique<KahanLi8Integrator>(inPool);
+	if (name == "dormandPrince") return std::make_unique<DormandPrinceIntegrator>(inSettings.tolerance, inPool);
+	if (name == "block") return std::make_unique<BlockTimestepIntegrator>(inSettings.timestepAccuracy, inPool);
+	if (name == "hermite") return std::make_unique<HermiteIntegrator>(inSettings.timestepAccuracy, inPool);
+	if (name == "wisdomHolman") return std::make_unique<WisdomHolmanIntegrator>(inPool);
+	if (name == "hybrid") return std::make_unique<HybridIntegrator>(inSettings.tolerance, inSettings.changeoverRadius, inPool);
+	if (name == "ias15") return std::make_unique<IAS15Integrator>(inPool);
+	if (name == "bulirschStoer") return std::make_unique<BulirschStoerIntegrator>(inSettings.tolerance, inPool);
+
+	std::cerr << "Error in config file. Integrator " << name << " is not recognised.\n";
+	throw std::invalid_argument("Error: unknown integrator in config.txt");
+}
@@ -0,0 +1,112 @@
+#ifndef Integrator_H
+#define Integrator_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include "BodySystem.h"
+#include "ForceSolver.h"
+#include "SimulationSettings.h"
+#include "ThreadPool.h"
+
+/*
+* An integrator advances the positions and velocities of every body in a system by one time step, calling on a force solver for the accelerations.
+* Which one is used is chosen by the integrator key in config.txt.
+*
+* Some integrators carry data over from one step to the next (for example the accelerations at the end of the last step). That data is only valid as long as nothing else
+* changes the bodies between steps, so reset() must be called whenever the system is changed outside of step(). Moving the origin does not count, as it changes no forces.
+*/
+
+class Integrator
+{
+protected:
+	ThreadPool*		 m_pool;
+	std::size_t		 m_steps{ 0 };
+	std::size_t		 m_forceEvaluations{ 0 };
+
+	//Every force evaluation goes through here, so that they can be counted.
+	void computeAccelerations(const ForceSolver& inSolver, const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc);
+	void computeAccelerations(const ForceSolver& inSolver, BodySystem& inBodies);
+	void computeSubsetAccelerations(const ForceSolver& inSolver, const BodySystem& inBodies, const BodyState& inState, const std::vector<std::uint32_t>& inTargets, AccelerationBuffer& outAcc);
+	void computeAccelerationsAndJerks(const ForceSolver& inSolver, const BodySystem& inBodies, const BodyState& inState, AccelerationBuffer& outAcc, AccelerationBuffer& outJerk);
+	//Throw std::runtime_error if an adaptive integrator asks for a step too short to get anywhere, as it does when a NaN in the state gets every step rejected.
+	//The shortest step allowed is minimumStepFraction of the output step inOutputStep, and never less than a few rounding errors of the time inTime.
+	void checkStepSize(double inStepSize, double inTime, double inOutputStep) const;
+
+public:
+	static constexpr double minimumStepFraction{ 1e-12 };
+
+	explicit Integrator(ThreadPool& inPool = ThreadPool::serial());
+	//Virtual default destructor as the integrators are used through base class pointers.
+	virtual ~Integrator() = default;
+
+	//Advance every body in inBodies by inTimeStep.
+	virtual void step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) = 0;
+	//Forget anything carried over from previous steps.
+	virtual void reset();
+
+	virtual std::string_view name() const = 0;
+	//Print a summary of the work done so far, such as the number of steps and force evaluations.
+	virtual void printStatistics(std::ostream& outStream) const;
+};
+
+
+//The first order Euler method, as in Planet::updateEuler. Both position and velocity are advanced using the values at the start of the step.
+class EulerIntegrator : public Integrator
+{
+public:
+	explicit EulerIntegrator(ThreadPool& inPool = ThreadPool::serial());
+
+	void step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) override;
+	std::string_view name() const override;
+};
+
+
+//The semi-implicit Euler (Euler-Cromer) method, as in Planet::updateEulerCromer. The velocity is advanced first, and the position with the new velocity.
+//Still first order, but symplectic, so orbits do not steadily gain or lose energy as they do with plain Euler.
+class EulerCromerIntegrator : public Integrator
+{
+public:
+	explicit EulerCromerIntegrator(ThreadPool& inPool = ThreadPool::serial());
+
+	void step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) override;
+	std::string_view name() const override;
+};
+
+
+/*
+* The kick-drift-kick leapfrog, also known as velocity Verlet. Second order and symplectic.
+*
+*	v(t + dt/2) = v(t) + a(t) dt/2					(kick)
+*	x(t + dt)   = x(t) + v(t + dt/2) dt				(drift)
+*	v(t + dt)   = v(t + dt/2) + a(t + dt) dt/2		(kick)
+*
+* The accelerations at the end of one step are those needed at the start of the next, so they are kept and only one force evaluation is needed per step,
+* the same as for the Euler methods. The error is proportional to dt^2 rather than dt, so the same accuracy can be had with a far larger time step.
+*/
+class LeapfrogIntegrator : public Integrator
+{
+	bool m_haveAccelerations{ false };						//Whether the system's accelerations are those of its current positions.
+
+protected:
+	//One kick-drift-kick of length inTimeStep, without counting it as a step. Shared with the composition integrators, which are built from several of these.
+	void kickDriftKick(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep);
+
+public:
+	explicit LeapfrogIntegrator(ThreadPool& inPool = ThreadPool::serial());
+
+	void step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) override;
+	void reset() override;
+	std::string_view name() const override;
+};
+
+
+//Create the integrator named in the settings read from config.txt. Throws std::invalid_argument for unrecognised names.
+std::unique_ptr<Integrator> makeIntegrator(const SimulationSettings& inSettings, ThreadPool& inPool);
+
+
+#endif
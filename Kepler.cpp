@@ -0,0 +1,86 @@
+#include <cmath>
+
+#include "Kepler.h"
+
+namespace {
+
+	constexpr std::size_t maxIterations{ 50 };
+	//The order of the Laguerre-Conway iteration. Five is the usual choice, and any value from about 3 upwards converges as well.
+	constexpr double laguerreOrder{ 5 };
+
+	struct Stumpff {
+		double c0, c1, c2, c3;
+	};
+
+	//The Stumpff functions c_0 to c_3 of x. The argument is divided by four until it is small enough for a short series, and the results
+	//are then built back up with the quadrupling identities, so the same code holds for large positive (elliptic) and negative (hyperbolic) x.
+	Stumpff stumpff(double inX) {
+		std::size_t quarterings{ 0 };
+		while (std::abs(inX) > 0.1) {
+			inX *= 0.25;
+			++quarterings;
+		}
+
+		//The series, c_k(x) = Sum( (-x)^n / (2n + k)! ), to five terms. With |x| <= 0.1 the next term is below 1e-14 of the first.
+		Stumpff c;
+		c.c3 = (1 - inX / 20 * (1 - inX / 42 * (1 - inX / 72 * (1 - inX / 110)))) / 6;
+		c.c2 = (1 - inX / 12 * (1 - inX / 30 * (1 - inX / 56 * (1 - inX / 90)))) / 2;
+		c.c1 = 1 - inX * c.c3;
+		c.c0 = 1 - inX * c.c2;
+
+		for (; quarterings > 0; --quarterings) {
+			c.c3 = 0.25 * (c.c2 + c.c0 * c.c3);
+			c.c2 = 0.5 * c.c1 * c.c1;
+			c.c1 = c.c0 * c.c1;
+			c.c0 = 2 * c.c0 * c.c0 - 1;
+		}
+		return c;
+	}
+
+}
+
+
+void Kepler::drift(double inMu, double inTime, std::size_t inCount, double* ioX, double* ioY, double* ioZ, double* ioVX, double* ioVY, double* ioVZ) {
+	for (std::size_t i = 0; i < inCount; ++i) {
+		const double r0{ std::sqrt(ioX[i] * ioX[i] + ioY[i] * ioY[i] + ioZ[i] * ioZ[i]) };
+		const double eta0{ ioX[i] * ioVX[i] + ioY[i] * ioVY[i] + ioZ[i] * ioVZ[i] };
+		const double v02{ ioVX[i] * ioVX[i] + ioVY[i] * ioVY[i] + ioVZ[i] * ioVZ[i] };
+		const double beta{ 2 * inMu / r0 - v02 };					//mu / a, positive for bound orbits.
+		const double zeta{ inMu - beta * r0 };
+
+		//Solve Kepler's equation F(s) = 0, where F' = r(s) is the distance from the central body and F'' its derivative.
+		double s{ inTime / r0 };
+		Stumpff c{ stumpff(beta * s * s) };
+		for (std::size_t iteration = 0; iteration < maxIterations; ++iteration) {
+			const double g1{ s * c.c1 };
+			const double g2{ s * s * c.c2 };
+			const double g3{ s * s * s * c.c3 };
+			const double F{ r0 * g1 + eta0 * g2 + inMu * g3 - inTime };
+			const double dF{ r0 * c.c0 + eta0 * g1 + inMu * g2 };
+			const double ddF{ eta0 * c.c0 + zeta * g1 };
+
+			const double root{ std::sqrt(std::abs((laguerreOrder - 1) * (laguerreOrder - 1) * dF * dF - laguerreOrder * (laguerreOrder - 1) * F * ddF)) };
+			const double ds{ -laguerreOrder * F / (dF + std::copysign(root, dF)) };
+			s += ds;
+			c = stumpff(beta * s * s);
+			if (std::abs(ds) <= 1e-15 * std::abs(s)) break;
+		}
+
+		const double g1{ s * c.c1 };
+		const double g2{ s * s * c.c2 };
+		const double r{ r0 * c.c0 + eta0 * g1 + inMu * g2 };
+
+		const double f{ 1 - inMu * g2 / r0 };
+		const double g{ r0 * g1 + eta0 * g2 };						//Equal to t - mu G3 by Kepler's equation, without the cancellation.
+		const double fDot{ -inMu * g1 / (r0 * r) };
+		const double gDot{ 1 - inMu * g2 / r };
+
+		const double x{ ioX[i] }, y{ ioY[i] }, z{ ioZ[i] };
+		ioX[i] = f * x + g * ioVX[i];
+		ioY[i] = f * y + g * ioVY[i];
+		ioZ[i] = f * z + g * ioVZ[i];
+		ioVX[i] = fDot * x + gDot * ioVX[i];
+		ioVY[i] = fDot * y + gDot * ioVY[i];
+		ioVZ[i] = fDot * z + gDot * ioVZ[i];
+	}
+}
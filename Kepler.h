@@ -0,0 +1,31 @@
+#ifndef Kepler_H
+#define Kepler_H
+
+#include <cstddef>
+
+/*
+* An analytic solver for two-body (Keplerian) motion, used by the Wisdom-Holman integrator to move each planet along its orbit about the central body.
+*
+* Rather than working with the eccentric anomaly, which needs separate formulae for elliptic, parabolic and hyperbolic orbits, the solver uses the universal
+* anomaly s and the Stumpff functions c_k, which cover all three at once. Kepler's equation then reads
+*
+*	r0 G1(s) + (r0 . v0) G2(s) + mu G3(s) = t,		with G_k(s) = s^k c_k(beta s^2) and beta = 2 mu / r0 - v0^2,
+*
+* and is solved for s by Laguerre-Conway iteration, which converges from the crude starting guess s = t / r0 for any orbit. The new position and velocity then
+* follow from the f and g functions, r = f r0 + g v0 and v = f' r0 + g' v0.
+*
+* Positions are relative to the central body, and velocities may be either relative to it or, as in democratic heliocentric coordinates, to the barycentre.
+*
+* Reference: Danby, J. M. A. (1988). Fundamentals of Celestial Mechanics, 2nd ed., chapter 6.
+*/
+
+namespace Kepler {
+
+	//Advance inCount orbits about a central body with gravitational parameter inMu (G times its mass) by inTime, in place. The arrays hold one orbit per entry,
+	//so any contiguous run of a structure-of-arrays state can be passed in directly.
+	void drift(double inMu, double inTime, std::size_t inCount, double* ioX, double* ioY, double* ioZ, double* ioVX, double* ioVY, double* ioVZ);
+
+}
+
+
+#endif
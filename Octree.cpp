@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+
+#include "Octree.h"
+
+
+Octree::Octree(const BodySystem& inBodies, const BodyState& inState, std::size_t inCount, std::size_t inLeafSize) : m_leafSize{ inLeafSize == 0 ? 1 : inLeafSize } {
+	const std::size_t count{ inCount };
+	m_nodes.reserve(2 * count / m_leafSize + 1);
+	m_nodes.emplace_back();
+	if (count == 0) return;
+
+	//The root cell is the smallest cube holding every body.
+	const auto [minX, maxX] { std::minmax_element(inState.x.begin(), inState.x.begin() + count) };
+	const auto [minY, maxY] { std::minmax_element(inState.y.begin(), inState.y.begin() + count) };
+	const auto [minZ, maxZ] { std::minmax_element(inState.z.begin(), inState.z.begin() + count) };
+	Node& root{ m_nodes[0] };
+	root.centreX = 0.5 * (*minX + *maxX);
+	root.centreY = 0.5 * (*minY + *maxY);
+	root.centreZ = 0.5 * (*minZ + *maxZ);
+	//Pad the cube very slightly so the bodies defining its edges are unambiguously inside it.
+	root.halfSize = 0.5 * std::max({ *maxX - *minX, *maxY - *minY, *maxZ - *minZ }) * (1 + 1e-12) + 1e-300;
+	root.bodyBegin = 0;
+	root.bodyEnd = static_cast<std::uint32_t>(count);
+
+	//Build the tree over the original positions, shuffling only the index array, then gather everything into tree order at the end.
+	m_x.assign(inState.x.begin(), inState.x.begin() + count);
+	m_y.assign(inState.y.begin(), inState.y.begin() + count);
+	m_z.assign(inState.z.begin(), inState.z.begin() + count);
+	m_mass.assign(inBodies.masses().begin(), inBodies.masses().begin() + count);
+	m_order.resize(count);
+	std::iota(m_order.begin(), m_order.end(), 0u);
+
+	std::vector<std::uint32_t> scratch(count);
+	buildNode(0, scratch, 0);
+
+	alignedArray_t<double> sortedX(count), sortedY(count), sortedZ(count), sortedMass(count);
+	m_softening2.resize(count);
+	for (std::size_t k = 0; k < count; ++k) {
+		sortedX[k] = m_x[m_order[k]];
+		sortedY[k] = m_y[m_order[k]];
+		sortedZ[k] = m_z[m_order[k]];
+		sortedMass[k] = m_mass[m_order[k]];
+		m_softening2[k] = inBodies.softening2()[m_order[k]];
+	}
+	m_x.swap(sortedX);
+	m_y.swap(sortedY);
+	m_z.swap(sortedZ);
+	m_mass.swap(sortedMass);
+}
+
+//Split a cell into its occupied octants and recurse. Nodes are only referred to by index here, as adding children can reallocate the node array.
+void Octree::buildNode(std::uint32_t inNode, std::vector<std::uint32_t>& scratch, std::size_t inDepth) {
+	const std::uint32_t begin{ m_nodes[inNode].bodyBegin };
+	const std::uint32_t end{ m_nodes[inNode].bodyEnd };
+	if (end - begin <= m_leafSize || inDepth >= maxDepth) {
+		computeMoments(inNode);
+		return;
+	}
+
+	const double centreX{ m_nodes[inNode].centreX };
+	const double centreY{ m_nodes[inNode].centreY };
+	const double centreZ{ m_nodes[inNode].centreZ };
+	const double quarter{ 0.5 * m_nodes[inNode].halfSize };
+
+	//Octant numbering: bit 0 set for the +x half, bit 1 for +y, bit 2 for +z.
+	auto octantOf = [&](std::uint32_t inBody) {
+		return (m_x[inBody] >= centreX ? 1u : 0u) | (m_y[inBody] >= centreY ? 2u : 0u) | (m_z[inBody] >= centreZ ? 4u : 0u);
+	};
+
+	//A counting sort groups the bodies of each octant together.
+	std::array<std::uint32_t, 8> counts{};
+	for (std::uint32_t k = begin; k < end; ++k) ++counts[octantOf(m_order[k])];
+	std::array<std::uint32_t, 8> offsets{};
+	std::uint32_t running{ begin };
+	std::uint32_t childCount{ 0 };
+	for (std::size_t octant = 0; octant < 8; ++octant) {
+		offsets[octant] = running;
+		running += counts[octant];
+		if (counts[octant] > 0) ++childCount;
+	}
+	std::array<std::uint32_t, 8> starts{ offsets };
+	for (std::uint32_t k = begin; k < end; ++k) scratch[offsets[octantOf(m_order[k])]++] = m_order[k];
+	std::copy(scratch.begin() + begin, scratch.begin() + end, m_order.begin() + begin);
+
+	//Children of a cell are allocated as one contiguous block before any of them is built.
+	const std::uint32_t firstChild{ static_cast<std::uint32_t>(m_nodes.size()) };
+	m_nodes[inNode].firstChild = firstChild;
+	m_nodes[inNode].childCount = childCount;
+	m_nodes.resize(m_nodes.size() + childCount);
+
+	std::uint32_t child{ firstChild };
+	for (std::uint32_t octant = 0; octant < 8; ++octant) {
+		if (counts[octant] == 0) continue;
+		Node& childNode{ m_nodes[child] };
+		childNode.centreX = centreX + ((octant & 1u) ? quarter : -quarter);
+		childNode.centreY = centreY + ((octant & 2u) ? quarter : -quarter);
+		childNode.centreZ = centreZ + ((octant & 4u) ? quarter : -quarter);
+		childNode.halfSize = quarter;
+		childNode.bodyBegin = starts[octant];
+		childNode.bodyEnd = starts[octant] + counts[octant];
+		++child;
+	}
+	for (std::uint32_t c = firstChild; c < firstChild + childCount; ++c) buildNode(c, scratch, inDepth + 1);
+
+	computeMoments(inNode);
+}
+
+//The moments of a leaf come straight from its bodies. Those of any other cell are built from its children's, using the parallel axis theorem
+//to move each child's quadrupole from the child's centre of mass to the parent's.
+void Octree::computeMoments(std::uint32_t inNode) {
+	Node& node{ m_nodes[inNode] };
+	double mass{ 0 };
+	double sumX{ 0 }, sumY{ 0 }, sumZ{ 0 };
+
+	if (node.isLeaf()) {
+		for (std::uint32_t k = node.bodyBegin; k < node.bodyEnd; ++k) {
+			const std::uint32_t i{ m_order[k] };
+			mass += m_mass[i];
+			sumX += m_mass[i] * m_x[i];
+			sumY += m_mass[i] * m_y[i];
+			sumZ += m_mass[i] * m_z[i];
+		}
+	}
+	else {
+		for (std::uint32_t c = node.firstChild; c < node.firstChild + node.childCount; ++c) {
+			const Node& child{ m_nodes[c] };
+			mass += child.mass;
+			sumX += child.mass * child.comX;
+			sumY += child.mass * child.comY;
+			sumZ += child.mass * child.comZ;
+		}
+	}
+
+	//A cell holding only massless bodies has no centre of mass, so we fall back on its geometric centre.
+	node.mass = mass;
+	node.comX = mass > 0 ? sumX / mass : node.centreX;
+	node.comY = mass > 0 ? sumY / mass : node.centreY;
+	node.comZ = mass > 0 ? sumZ / mass : node.centreZ;
+
+	double qxx{ 0 }, qyy{ 0 }, qzz{ 0 }, qxy{ 0 }, qxz{ 0 }, qyz{ 0 };
+	double radius{ 0 };
+	auto addPointMass = [&](double m, double dx, double dy, double dz) {
+		const double r2{ dx * dx + dy * dy + dz * dz };
+		qxx += m * (3 * dx * dx - r2);
+		qyy += m * (3 * dy * dy - r2);
+		qzz += m * (3 * dz * dz - r2);
+		qxy += m * 3 * dx * dy;
+		qxz += m * 3 * dx * dz;
+		qyz += m * 3 * dy * dz;
+	};
+
+	if (node.isLeaf()) {
+		for (std::uint32_t k = node.bodyBegin; k < node.bodyEnd; ++k) {
+			const std::uint32_t i{ m_order[k] };
+			const double dx{ m_x[i] - node.comX };
+			const double dy{ m_y[i] - node.comY };
+			const double dz{ m_z[i] - node.comZ };
+			addPointMass(m_mass[i], dx, dy, dz);
+			radius = std::max(radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+		}
+	}
+	else {
+		for (std::uint32_t c = node.firstChild; c < node.firstChild + node.childCount; ++c) {
+			const Node& child{ m_nodes[c] };
+			const double dx{ child.comX - node.comX };
+			const double dy{ child.comY - node.comY };
+			const double dz{ child.comZ - node.comZ };
+			addPointMass(child.mass, dx, dy, dz);
+			qxx += child.qxx;
+			qyy += child.qyy;
+			qzz += child.qzz;
+			qxy += child.qxy;
+			qxz += child.qxz;
+			qyz += child.qyz;
+			radius = std::max(radius, std::sqrt(dx * dx + dy * dy + dz * dz) + child.radius);
+		}
+	}
+	node.qxx = qxx;
+	node.qyy = qyy;
+	node.qzz = qzz;
+	node.qxy = qxy;
+	node.qxz = qxz;
+	node.qyz = qyz;
+	node.radius = radius;
+}
+
+
+const std::vector<Octree::Node>& Octree::nodes() const {
+	return m_nodes;
+}
+const std::vector<std::uint32_t>& Octree::order() const {
+	return m_order;
+}
+const alignedArray_t<double>& Octree::x() const {
+	return m_x;
+}
+const alignedArray_t<double>& Octree::y() const {
+	return m_y;
+}
+const alignedArray_t<double>& Octree::z() const {
+	return m_z;
+}
+const alignedArray_t<double>& Octree::masses() const {
+	return m_mass;
+}
+const alignedArray_t<double>& Octree::softening2() const {
+	return m_softening2;
+}
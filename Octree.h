@@ -0,0 +1,67 @@
+#ifndef Octree_H
+#define Octree_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "BodySystem.h"
+
+/*
+* An octree over the bodies of a system, built from one snapshot of their positions.
+* Space is divided into a cube holding every body, which is split into eight octants, and so on, until each cell (a "leaf") holds only a handful of bodies.
+* Each cell records the total mass, centre of mass and quadrupole moment of everything inside it, which is what the tree codes use to stand in for the
+* individual bodies when the cell is far enough away.
+*
+* The bodies are reordered as the tree is built so that every cell's contents are a contiguous range of the tree-ordered arrays. This keeps the
+* bodies of one leaf next to each other in memory, and order() maps back to each body's index in the original system.
+*/
+
+class Octree
+{
+public:
+	//One cell of the tree. The children of a cell are stored next to each other in the node array.
+	struct Node {
+		double			 centreX{ 0 }, centreY{ 0 }, centreZ{ 0 };	//Geometric centre of the cell.
+		double			 halfSize{ 0 };								//Half the side length of the cell.
+		double			 comX{ 0 }, comY{ 0 }, comZ{ 0 };			//Centre of mass.
+		double			 mass{ 0 };
+		double			 qxx{ 0 }, qyy{ 0 }, qzz{ 0 };				//Traceless quadrupole moment about the centre of mass, Sum( m (3 x_i x_j - r^2 delta_ij) ).
+		double			 qxy{ 0 }, qxz{ 0 }, qyz{ 0 };
+		double			 radius{ 0 };								//Distance from the centre of mass to the furthest body in the cell.
+		std::uint32_t	 firstChild{ 0 };
+		std::uint32_t	 childCount{ 0 };							//Zero for a leaf.
+		std::uint32_t	 bodyBegin{ 0 };							//The range of tree-ordered bodies inside this cell.
+		std::uint32_t	 bodyEnd{ 0 };
+
+		bool isLeaf() const { return childCount == 0; }
+	};
+
+private:
+	static constexpr std::size_t maxDepth{ 48 };					//Past this depth, bodies are so close together that we stop splitting and accept a larger leaf.
+
+	std::vector<Node>			 m_nodes;							//The root is always node 0.
+	std::vector<std::uint32_t>	 m_order;							//Tree position -> index in the original system.
+	alignedArray_t<double>		 m_x, m_y, m_z, m_mass;				//Positions and masses in tree order.
+	alignedArray_t<double>		 m_softening2;						//And squared softening lengths.
+	std::size_t					 m_leafSize;
+
+	void buildNode(std::uint32_t inNode, std::vector<std::uint32_t>& scratch, std::size_t inDepth);
+	void computeMoments(std::uint32_t inNode);
+
+public:
+	//Build the tree over the first inCount bodies in inState. Cells holding inLeafSize or fewer bodies are not split any further.
+	//Passing inBodies.activeCount() builds it over the massive bodies alone, leaving out the test particles which contribute nothing to it.
+	Octree(const BodySystem& inBodies, const BodyState& inState, std::size_t inCount, std::size_t inLeafSize = 8);
+
+	const std::vector<Node>& nodes() const;
+	const std::vector<std::uint32_t>& order() const;
+	const alignedArray_t<double>& x() const;
+	const alignedArray_t<double>& y() const;
+	const alignedArray_t<double>& z() const;
+	const alignedArray_t<double>& masses() const;
+	const alignedArray_t<double>& softening2() const;
+};
+
+
+#endif
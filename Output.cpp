@@ -0,0 +1,430 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "Output.h"
+#include "AsyncWriter.h"
+
+namespace {
+	constexpr char binaryMagic[8]{ 'N', 'B', 'O', 'D', 'Y', 'T', 'R', 'J' };
+	constexpr std::string_view binaryUnits{ "length m, mass kg, time s" };
+
+	bool hostIsLittleEndian() {
+		const std::uint32_t one{ 1 };
+		unsigned char firstByte;
+		std::memcpy(&firstByte, &one, 1);
+		return firstByte == 1;
+	}
+
+	//Write inCount values as little-endian. On little-endian machines, which is nearly all of them, the values go straight from memory to the file.
+	template<typename T>
+	void writeLittleEndian(std::ostream& outStream, const T* inValues, std::size_t inCount) {
+		if (hostIsLittleEndian()) {
+			outStream.write(reinterpret_cast<const char*>(inValues), static_cast<std::streamsize>(sizeof(T) * inCount));
+			return;
+		}
+		for (std::size_t i = 0; i < inCount; ++i) {
+			char bytes[sizeof(T)];
+			std::memcpy(bytes, inValues + i, sizeof(T));
+			for (std::size_t b = 0; b < sizeof(T) / 2; ++b) std::swap(bytes[b], bytes[sizeof(T) - 1 - b]);
+			outStream.write(bytes, sizeof(T));
+		}
+	}
+	template<typename T>
+	void writeLittleEndian(std::ostream& outStream, T inValue) {
+		writeLittleEndian(outStream, &inValue, 1);
+	}
+	void writeString(std::ostream& outStream, std::string_view inString) {
+		writeLittleEndian(outStream, static_cast<std::uint32_t>(inString.size()));
+		outStream.write(inString.data(), static_cast<std::streamsize>(inString.size()));
+	}
+
+	//Reads the binary layout back, keeping count of the bytes left in the file. Counts and lengths read from the file are checked against that before anything
+	//that size is allocated, so that a corrupt file cannot ask for more memory than it could possibly fill. The size of the file is found once, when the reader
+	//is made, and the count kept up to date from then on, rather than the stream being asked where it is on every read. If the stream cannot tell its size,
+	//the count starts at the largest number there is, and the checks never fail.
+	class BinaryReader
+	{
+		std::istream*	 m_stream;
+		std::uint64_t	 m_remaining;
+
+	public:
+		explicit BinaryReader(std::istream& inStream) : m_stream{ &inStream }, m_remaining{ std::numeric_limits<std::uint64_t>::max() } {
+			const std::istream::pos_type position{ inStream.tellg() };
+			if (position == std::istream::pos_type(-1)) return;
+			inStream.seekg(0, std::ios::end);
+			const std::istream::pos_type end{ inStream.tellg() };
+			inStream.seekg(position);
+			if (end != std::istream::pos_type(-1)) m_remaining = end < position ? 0 : static_cast<std::uint64_t>(end - position);
+		}
+
+		std::uint64_t remaining() const {
+			return m_remaining;
+		}
+
+		//The readers return false if the file ends first.
+		template<typename T>
+		bool read(T* outValues, std::size_t inCount) {
+			const std::uint64_t byteCount{ sizeof(T) * static_cast<std::uint64_t>(inCount) };
+			if (byteCount > m_remaining || !m_stream->read(reinterpret_cast<char*>(outValues), static_cast<std::streamsize>(byteCount))) return false;
+			m_remaining -= byteCount;
+			if (!hostIsLittleEndian()) {
+				for (std::size_t i = 0; i < inCount; ++i) {
+					char* bytes{ reinterpret_cast<char*>(outValues + i) };
+					for (std::size_t b = 0; b < sizeof(T) / 2; ++b) std::swap(bytes[b], bytes[sizeof(T) - 1 - b]);
+				}
+			}
+			return true;
+		}
+		template<typename T>
+		bool read(T& outValue) {
+			return read(&outValue, 1);
+		}
+		bool readString(std::string& outString) {
+			std::uint32_t length;
+			if (!read(length) || length > m_remaining) return false;
+			outString.resize(length);
+			return length == 0 || read(outString.data(), length);
+		}
+	};
+
+	std::ofstream openOutput(const std::string& inFileName, std::ios::openmode inMode = std::ios::out) {
+		std::ofstream file(inFileName, inMode);
+		if (!file) {
+			std::cerr << "Output file " << inFileName << " could not be opened for writing.\n";
+			throw std::invalid_argument("Error: output file could not be opened");
+		}
+		return file;
+	}
+}
+
+
+TrajectoryWriter::TrajectoryWriter(const std::string& inFileName) : m_fileName{ inFileName } {}
+
+void TrajectoryWriter::finish() {}
+void TrajectoryWriter::printStatistics(std::ostream&) const {}
+const std::string& TrajectoryWriter::fileName() const {
+	return m_fileName;
+}
+
+
+//CSV
+CsvFormatter::CsvFormatter(std::ostream& inStream, int inPrecision, bool inWriteTime) : m_stream{ &inStream }, m_precision{ inPrecision }, m_writeTime{ inWriteTime }, m_buffer(bufferSize) {
+	if (m_precision < 0 || m_precision > 17) {
+		std::cerr << "Error in config file. outputPrecision must be between 0 and 17, not " << m_precision << ".\n";
+		throw std::invalid_argument("Error: outputPrecision out of range in config.txt");
+	}
+}
+CsvFormatter::~CsvFormatter() {
+	flush();
+}
+
+void CsvFormatter::flush() {
+	m_stream->write(m_buffer.data(), static_cast<std::streamsize>(m_used));
+	m_used = 0;
+}
+
+void CsvFormatter::writeNumber(double inValue) {
+	if (bufferSize - m_used < maxNumberLength + 1) flush();
+	char* const first{ m_buffer.data() + m_used };
+	char* const last{ m_buffer.data() + bufferSize };
+	const std::to_chars_result result{ m_precision == 0 ? std::to_chars(first, last, inValue) : std::to_chars(first, last, inValue, std::chars_format::general, m_precision) };
+	*result.ptr = ',';
+	m_used = static_cast<std::size_t>(result.ptr + 1 - m_buffer.data());
+}
+
+//The names go through the stream itself, as they could be longer than the buffer. Headers are rare enough for that not to matter.
+void CsvFormatter::writeHeader(const std::vector<std::string>& inNames) {
+	flush();
+	if (m_writeTime) *m_stream << "time,";
+	for (const auto& name : inNames) {
+		*m_stream << name << "X," << name << "Y," << name << "Z,";
+	}
+	*m_stream << '\n';
+}
+
+void CsvFormatter::writeRow(double inTime, const double* inX, const double* inY, const double* inZ, std::size_t inCount) {
+	if (m_writeTime) writeNumber(inTime);
+	for (std::size_t i = 0; i < inCount; ++i) {
+		writeNumber(inX[i]);
+		writeNumber(inY[i]);
+		writeNumber(inZ[i]);
+	}
+	if (m_used == bufferSize) flush();
+	m_buffer[m_used++] = '\n';
+}
+
+
+CsvWriter::CsvWriter(int inPrecision, bool inWriteTime, const std::string& inFileName) : TrajectoryWriter{ inFileName }, m_file{ openOutput(inFileName) }, m_formatter{ m_file, inPrecision, inWriteTime } {}
+
+void CsvWriter::writeBodies(const std::vector<std::string>& inNames, const alignedArray_t<double>&) {
+	m_formatter.writeHeader(inNames);
+}
+//Each row starts with its time if the formatter was asked for it. Otherwise the file keeps the layout it has always had, with each row one time step after the last.
+void CsvWriter::writeSnapshot(double inTime, const BodyState& inState) {
+	m_formatter.writeRow(inTime, inState.x.data(), inState.y.data(), inState.z.data(), inState.size());
+}
+void CsvWriter::finish() {
+	m_formatter.flush();
+	m_file.flush();
+}
+
+
+//Binary
+BinaryWriter::BinaryWriter(double inTimeStep, const std::string& inFileName) : TrajectoryWriter{ inFileName }, m_file{ openOutput(inFileName, std::ios::out | std::ios::binary) } {
+	m_file.write(binaryMagic, sizeof(binaryMagic));
+	writeLittleEndian(m_file, layoutVersion);
+	writeLittleEndian(m_file, inTimeStep);
+	writeString(m_file, binaryUnits);
+}
+
+void BinaryWriter::writeBodies(const std::vector<std::string>& inNames, const alignedArray_t<double>& inMasses) {
+	writeLittleEndian(m_file, bodiesRecord);
+	writeLittleEndian(m_file, static_cast<std::uint64_t>(inNames.size()));
+	for (std::size_t i = 0; i < inNames.size(); ++i) {
+		writeString(m_file, inNames[i]);
+		writeLittleEndian(m_file, inMasses[i]);
+	}
+}
+//The state is already stored as one array per component, so each column is a single write.
+void BinaryWriter::writeSnapshot(double inTime, const BodyState& inState) {
+	writeLittleEndian(m_file, snapshotRecord);
+	writeLittleEndian(m_file, inTime);
+	writeLittleEndian(m_file, inState.x.data(), inState.size());
+	writeLittleEndian(m_file, inState.y.data(), inState.size());
+	writeLittleEndian(m_file, inState.z.data(), inState.size());
+}
+
+
+//Compressed
+CompressedWriter::CompressedWriter(double inTimeStep, const std::string& inFileName) : BinaryWriter{ inTimeStep, inFileName } {}
+
+void CompressedWriter::writeBlock() {
+	if (m_compressor.snapshots() == 0) return;
+	const std::vector<std::uint8_t>& block{ m_compressor.block() };
+	writeLittleEndian(m_file, compressedRecord);
+	writeLittleEndian(m_file, static_cast<std::uint32_t>(m_compressor.snapshots()));
+	writeLittleEndian(m_file, static_cast<std::uint64_t>(block.size()));
+	m_file.write(reinterpret_cast<const char*>(block.data()), static_cast<std::streamsize>(block.size()));
+	m_compressedBytes += sizeof(std::uint32_t) * 2 + sizeof(std::uint64_t) + block.size();
+	m_compressor.clear();
+}
+
+//The snapshots so far describe the old bodies, so they are written before the new description, and compression starts again for the new columns.
+void CompressedWriter::writeBodies(const std::vector<std::string>& inNames, const alignedArray_t<double>& inMasses) {
+	writeBlock();
+	BinaryWriter::writeBodies(inNames, inMasses);
+	m_compressor.reset(1 + 3 * inNames.size());
+	m_columns.resize(m_compressor.columns());
+}
+
+void CompressedWriter::writeSnapshot(double inTime, const BodyState& inState) {
+	const std::size_t count{ inState.size() };
+	m_columns[0] = inTime;
+	std::copy(inState.x.begin(), inState.x.begin() + count, m_columns.begin() + 1);
+	std::copy(inState.y.begin(), inState.y.begin() + count, m_columns.begin() + 1 + count);
+	std::copy(inState.z.begin(), inState.z.begin() + count, m_columns.begin() + 1 + 2 * count);
+	m_compressor.compress(m_columns.data());
+	m_rawBytes += sizeof(std::uint32_t) + sizeof(double) * m_columns.size();
+	if (m_compressor.size() >= blockBytes) writeBlock();
+}
+
+void CompressedWriter::finish() {
+	writeBlock();
+	m_file.flush();
+}
+
+void CompressedWriter::printStatistics(std::ostream& outStream) const {
+	if (m_compressedBytes == 0) return;
+	outStream << "Snapshots compressed to " << 100.0 * static_cast<double>(m_compressedBytes) / static_cast<double>(m_rawBytes) << "% of their size in the binary format ("
+		<< static_cast<double>(m_rawBytes) / static_cast<double>(m_compressedBytes) << " times smaller).\n";
+}
+
+
+//Output schedule
+OutputSchedule::OutputSchedule(const SimulationSettings& inSettings) : m_interval{ inSettings.outputInterval }, m_times{ inSettings.outputTimes } {
+	if (m_interval < 0 || std::any_of(m_times.begin(), m_times.end(), [](double t) { return t < 0; })) {
+		std::cerr << "Error in config file. outputInterval and outputTimes must not be negative.\n";
+		throw std::invalid_argument("Error: negative output time in config.txt");
+	}
+	std::sort(m_times.begin(), m_times.end());
+	m_times.erase(std::unique(m_times.begin(), m_times.end()), m_times.end());
+}
+
+bool OutputSchedule::everyStep() const {
+	return m_interval <= 0 && m_times.empty();
+}
+//Interval times are worked out by multiplying rather than by adding up the interval, so that they do not drift.
+double OutputSchedule::nextTime() const {
+	double next{ std::numeric_limits<double>::infinity() };
+	if (m_interval > 0) next = static_cast<double>(m_intervalsDone + 1) * m_interval;
+	if (m_nextListed < m_times.size()) next = std::min(next, m_times[m_nextListed]);
+	return next;
+}
+//Move past inTime in both the interval and the list, so a time in both is only written once.
+void OutputSchedule::advance(double inTime) {
+	if (m_interval > 0 && static_cast<double>(m_intervalsDone + 1) * m_interval <= inTime) ++m_intervalsDone;
+	if (m_nextListed < m_times.size() && m_times[m_nextListed] <= inTime) ++m_nextListed;
+}
+
+void OutputSchedule::writeStart(double inTime, const BodyState& inState, TrajectoryWriter& outWriter) {
+	if (everyStep()) return;
+	while (nextTime() <= inTime) {
+		const double time{ nextTime() };
+		outWriter.writeSnapshot(time, inState);
+		++m_written;
+		advance(time);
+	}
+}
+
+void OutputSchedule::beginStep(double inStartTime, double inEndTime, const BodyState& inState) {
+	m_haveStart = !everyStep() && nextTime() < inEndTime;
+	if (m_haveStart) {
+		m_startTime = inStartTime;
+		m_start = inState;
+	}
+}
+
+void OutputSchedule::endStep(double inEndTime, const BodyState& inState, TrajectoryWriter& outWriter) {
+	if (everyStep()) {
+		outWriter.writeSnapshot(inEndTime, inState);
+		++m_written;
+		return;
+	}
+
+	//The simulation time is a running total of time steps, so a time meant to fall on the end of a step may miss it by a rounding error either way.
+	const double slack{ 1e-12 * std::abs(inEndTime) };
+	const std::size_t count{ inState.size() };
+	for (double time{ nextTime() }; time <= inEndTime + slack; time = nextTime()) {
+		if (!m_haveStart || time >= inEndTime - slack) outWriter.writeSnapshot(time, inState);
+		else {
+			//The cubic Hermite basis functions, with the two velocity terms scaled by the length of the step.
+			const double h{ inEndTime - m_startTime };
+			const double s{ (time - m_startTime) / h };
+			const double s2{ s * s };
+			const double s3{ s2 * s };
+			const double startWeight{ 2 * s3 - 3 * s2 + 1 };
+			const double startVelocityWeight{ (s3 - 2 * s2 + s) * h };
+			const double endWeight{ 3 * s2 - 2 * s3 };
+			const double endVelocityWeight{ (s3 - s2) * h };
+			m_interpolated.x.resize(count);
+			m_interpolated.y.resize(count);
+			m_interpolated.z.resize(count);
+			for (std::size_t i = 0; i < count; ++i) {
+				m_interpolated.x[i] = startWeight * m_start.x[i] + startVelocityWeight * m_start.vx[i] + endWeight * inState.x[i] + endVelocityWeight * inState.vx[i];
+				m_interpolated.y[i] = startWeight * m_start.y[i] + startVelocityWeight * m_start.vy[i] + endWeight * inState.y[i] + endVelocityWeight * inState.vy[i];
+				m_interpolated.z[i] = startWeight * m_start.z[i] + startVelocityWeight * m_start.vz[i] + endWeight * inState.z[i] + endVelocityWeight * inState.vz[i];
+			}
+			outWriter.writeSnapshot(time, m_interpolated);
+		}
+		++m_written;
+		advance(time);
+	}
+}
+
+std::size_t OutputSchedule::written() const {
+	return m_written;
+}
+
+
+std::unique_ptr<TrajectoryWriter> makeTrajectoryWriter(const SimulationSettings& inSettings) {
+	const std::string& format{ inSettings.outputFormat };
+	std::unique_ptr<TrajectoryWriter> writer;
+	//The rows need their times once they are not simply one per step.
+	const bool writeTime{ inSettings.outputTime || inSettings.outputInterval > 0 || !inSettings.outputTimes.empty() };
+	if (format == "csv") writer = std::make_unique<CsvWriter>(inSettings.outputPrecision, writeTime);
+	else if (format == "binary") writer = std::make_unique<BinaryWriter>(inSettings.timeStep);
+	else if (format == "compressed") writer = std::make_unique<CompressedWriter>(inSettings.timeStep);
+	else {
+		std::cerr << "Error in config file. Output format " << format << " is not recognised.\n";
+		throw std::invalid_argument("Error: unknown outputFormat in config.txt");
+	}
+
+	if (inSettings.asyncOutput) {
+		const std::size_t budget{ static_cast<std::size_t>(inSettings.outputMemory * 1024 * 1024) };
+		return std::make_unique<AsyncWriter>(std::move(writer), budget);
+	}
+	return writer;
+}
+
+std::size_t convertBinaryToCsv(std::istream& inBinary, std::ostream& outCsv, int inPrecision, bool inWriteTime) {
+	BinaryReader reader{ inBinary };
+	char magic[sizeof(binaryMagic)];
+	std::uint32_t version{ 0 };
+	double timeStep;
+	std::string units;
+	if (!reader.read(magic, sizeof(magic)) || std::memcmp(magic, binaryMagic, sizeof(magic)) != 0 || !reader.read(version)
+		|| !reader.read(timeStep) || !reader.readString(units)) {
+		std::cerr << "The file to convert is not a binary trajectory.\n";
+		throw std::invalid_argument("Error: not a binary trajectory file");
+	}
+	if (version != BinaryWriter::layoutVersion) {
+		std::cerr << "The binary trajectory has layout version " << version << ", but only version " << BinaryWriter::layoutVersion << " can be read.\n";
+		throw std::invalid_argument("Error: unsupported binary trajectory version");
+	}
+
+	CsvFormatter formatter{ outCsv, inPrecision, inWriteTime };
+	TrajectoryDecompressor decompressor;
+	std::vector<std::string> names;
+	std::vector<double> columns;
+	std::vector<std::uint8_t> block;
+	std::size_t snapshots{ 0 };
+	bool haveBodies{ false };
+	std::uint32_t record;
+	while (reader.read(record)) {
+		if (record != BinaryWriter::bodiesRecord && !haveBodies) {
+			std::cerr << "The binary trajectory has a snapshot before any description of the bodies.\n";
+			throw std::invalid_argument("Error: corrupt binary trajectory");
+		}
+
+		//Counts and sizes larger than the rest of the file could hold are taken as the file having been cut short.
+		if (record == BinaryWriter::bodiesRecord) {
+			//Each body takes at least a name length and a mass.
+			constexpr std::uint64_t smallestBody{ sizeof(std::uint32_t) + sizeof(double) };
+			std::uint64_t count;
+			if (!reader.read(count) || count > reader.remaining() / smallestBody) break;
+			names.resize(count);
+			double mass;
+			bool complete{ true };
+			for (auto& name : names) complete = complete && reader.readString(name) && reader.read(mass);
+			if (!complete) break;
+			formatter.writeHeader(names);
+			decompressor.reset(1 + 3 * count);
+			haveBodies = true;
+		}
+		else if (record == BinaryWriter::snapshotRecord) {
+			const std::size_t count{ names.size() };
+			double time;
+			columns.resize(3 * count);
+			if (!reader.read(time) || !reader.read(columns.data(), columns.size())) break;
+			formatter.writeRow(time, columns.data(), columns.data() + count, columns.data() + 2 * count, count);
+			++snapshots;
+		}
+		else if (record == BinaryWriter::compressedRecord) {
+			//The decompressed columns start with the time, then the positions.
+			const std::size_t count{ names.size() };
+			std::uint32_t blockSnapshots;
+			std::uint64_t blockSize;
+			if (!reader.read(blockSnapshots) || !reader.read(blockSize) || blockSize > reader.remaining()) break;
+			block.resize(blockSize);
+			if (!reader.read(block.data(), block.size())) break;
+			columns.resize(1 + 3 * count);
+			decompressor.startBlock(block.data(), block.size());
+			for (std::uint32_t i = 0; i < blockSnapshots; ++i) {
+				decompressor.decompress(columns.data());
+				formatter.writeRow(columns[0], columns.data() + 1, columns.data() + 1 + count, columns.data() + 1 + 2 * count, count);
+				++snapshots;
+			}
+		}
+		else {
+			std::cerr << "Unknown record type " << record << " in binary trajectory, after " << snapshots << " snapshots.\n";
+			throw std::invalid_argument("Error: corrupt binary trajectory");
+		}
+	}
+	return snapshots;
+}
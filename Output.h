@@ -0,0 +1,202 @@
+#ifndef Output_H
+#define Output_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BodySystem.h"
+#include "Compression.h"
+#include "SimulationSettings.h"
+
+/*
+* Writers for the trajectory, the positions of every body at each output time: after every step, unless OutputSchedule below says otherwise.
+* Which one is used is chosen by the outputFormat key in config.txt.
+*
+*	csv		One text row per snapshot, as cppOutputFile.csv, with an x, y and z column for each body. A header row of column names starts the file,
+*			and another follows each merge, as the columns change. Numbers are written in full unless outputPrecision sets a number of digits.
+*			Each row starts with a time column too if outputTime is set, or if outputInterval or outputTimes mean the rows are not one per step.
+*	binary	The same positions as raw doubles, in cppOutputFile.nbody. Every bit of every value is kept, yet the file is smaller than even six digit
+*			text, and writing it costs almost nothing, where formatting the text takes much of the run time for small systems.
+*	compressed	The binary layout, in cppOutputFile.nbz, with the snapshots compressed losslessly as described in Compression.h. For the solar system
+*			written every hour the file is about a tenth the size of the binary one, and with daily samples under a third of it.
+*
+* The binary layout is self-describing. Every number is little-endian, whatever machine wrote it, and strings are a uint32 length followed by that many bytes.
+*
+*	Header		char[8] "NBODYTRJ", uint32 layout version (1), float64 integration time step in s, string describing the units.
+*	Records		Each starts with a uint32 record type, and runs to the start of the next:
+*		1 Bodies	uint64 body count n, then a string name and a float64 mass in kg for each body. Written before the first snapshot, and again after
+*					every merge. It describes the snapshots which follow it.
+*		2 Snapshot	float64 time in s, then the columns: n float64 x positions, n y positions and n z positions, in m, in the order of the bodies record.
+*		3 Compressed	uint32 snapshot count, uint64 byte count, then that many bytes holding that many snapshots, compressed. Each snapshot's columns are
+*					its time then the x, y and z columns of a snapshot record. Compression starts afresh after each bodies record, and carries on from
+*					one compressed record to the next until then, so they can only be read in order.
+*
+* The file can be read from any language, for example with numpy by skipping the records' headers, and "SolarSystem convert file.nbody" turns it into
+* the CSV file the simulation would otherwise have written.
+*/
+
+class TrajectoryWriter
+{
+protected:
+	std::string		 m_fileName;
+
+public:
+	explicit TrajectoryWriter(const std::string& inFileName);
+	//Virtual default destructor as the writers are used through base class pointers.
+	virtual ~TrajectoryWriter() = default;
+
+	//Describe the bodies whose positions follow, by their names and masses, one of each per body. Called before the first snapshot, and again whenever
+	//the bodies change. Passing just these, rather than the whole BodySystem, means the asynchronous writer need copy nothing more.
+	virtual void writeBodies(const std::vector<std::string>& inNames, const alignedArray_t<double>& inMasses) = 0;
+	//Write the position of every body at time inTime. Only the positions in inState are read, so a snapshot need not carry the velocities.
+	virtual void writeSnapshot(double inTime, const BodyState& inState) = 0;
+	//Finish writing everything passed in so far. Called once, after the last snapshot.
+	virtual void finish();
+	virtual void printStatistics(std::ostream& outStream) const;
+	const std::string& fileName() const;
+};
+
+
+//Formats CSV text into a large buffer with std::to_chars, and hands it to the stream in big writes. Going through the stream for every number costs a locale
+//lookup and several virtual calls each time, and with its default precision of 6 digits the numbers could not be read back to the values written.
+//A precision of 0 writes each number with the fewest digits which read back to exactly the same double, and otherwise with that many significant digits.
+//The time of each row is only written as a column of its own if asked for, so that files written every step keep the layout they have always had.
+//Shared by the csv writer and the converter, so that the two always agree.
+class CsvFormatter
+{
+	std::ostream*		 m_stream;
+	int					 m_precision;
+	bool				 m_writeTime;
+	std::vector<char>	 m_buffer;
+	std::size_t			 m_used{ 0 };
+
+	void writeNumber(double inValue);
+
+public:
+	static constexpr std::size_t bufferSize{ std::size_t{ 1 } << 20 };
+	static constexpr std::size_t maxNumberLength{ 32 };		//Longer than any double written by to_chars, at any precision up to 17.
+
+	CsvFormatter(std::ostream& inStream, int inPrecision, bool inWriteTime);
+	~CsvFormatter();
+
+	CsvFormatter(const CsvFormatter&) = delete;
+	CsvFormatter& operator=(const CsvFormatter&) = delete;
+
+	//The header names the x, y and z columns of each body, after a time column if there is one, and each row fills them in.
+	void writeHeader(const std::vector<std::string>& inNames);
+	void writeRow(double inTime, const double* inX, const double* inY, const double* inZ, std::size_t inCount);
+	//Hand everything formatted so far to the stream.
+	void flush();
+};
+
+
+class CsvWriter : public TrajectoryWriter
+{
+	std::ofstream	 m_file;
+	CsvFormatter	 m_formatter;
+
+public:
+	explicit CsvWriter(int inPrecision = 0, bool inWriteTime = false, const std::string& inFileName = "cppOutputFile.csv");
+
+	void writeBodies(const std::vector<std::string>& inNames, const alignedArray_t<double>& inMasses) override;
+	void writeSnapshot(double inTime, const BodyState& inState) override;
+	void finish() override;
+};
+
+
+class BinaryWriter : public TrajectoryWriter
+{
+protected:
+	std::ofstream	 m_file;
+
+public:
+	static constexpr std::uint32_t layoutVersion{ 1 };
+	static constexpr std::uint32_t bodiesRecord{ 1 };
+	static constexpr std::uint32_t snapshotRecord{ 2 };
+	static constexpr std::uint32_t compressedRecord{ 3 };
+
+	explicit BinaryWriter(double inTimeStep, const std::string& inFileName = "cppOutputFile.nbody");
+
+	void writeBodies(const std::vector<std::string>& inNames, const alignedArray_t<double>& inMasses) override;
+	void writeSnapshot(double inTime, const BodyState& inState) override;
+};
+
+
+//Compressing costs less than formatting text, but far more than writing raw doubles, so with asyncOutput set it is done on the output thread, away from the simulation.
+//Snapshots are gathered into records of about blockBytes each, which a run stopped early loses the last of.
+class CompressedWriter : public BinaryWriter
+{
+	TrajectoryCompressor	 m_compressor;
+	std::vector<double>		 m_columns;
+	std::uint64_t			 m_rawBytes{ 0 };			//The size the snapshots would have taken in snapshot records, for the statistics.
+	std::uint64_t			 m_compressedBytes{ 0 };
+
+	void writeBlock();
+
+public:
+	static constexpr std::size_t blockBytes{ std::size_t{ 1 } << 20 };
+
+	explicit CompressedWriter(double inTimeStep, const std::string& inFileName = "cppOutputFile.nbz");
+
+	void writeBodies(const std::vector<std::string>& inNames, const alignedArray_t<double>& inMasses) override;
+	void writeSnapshot(double inTime, const BodyState& inState) override;
+	void finish() override;
+	void printStatistics(std::ostream& outStream) const override;
+};
+
+
+/*
+* Decides when the trajectory is written, independently of the integration step, and works out the positions at those times.
+*
+* By default every step is written, as it always has been. With outputInterval set, a snapshot is written every outputInterval seconds instead, and with
+* outputTimes, at each of the times listed; if both are set, at all of those times. A snapshot which falls inside a step is interpolated from the states at either
+* end of it with a cubic Hermite polynomial, which matches the positions and velocities at both ends. Its error grows as the fourth power of the time step,
+* the same order as the integrators' own for all but the simplest, so daily samples can be taken from a run with one minute steps without writing the other
+* 1439 steps of each day. A snapshot which falls on the end of a step is written exactly.
+*/
+class OutputSchedule
+{
+	double					 m_interval{ 0 };
+	std::vector<double>		 m_times;						//The listed output times, sorted.
+	std::size_t				 m_nextListed{ 0 };
+	std::size_t				 m_intervalsDone{ 0 };
+	std::size_t				 m_written{ 0 };
+
+	bool					 m_haveStart{ false };			//Whether the state at the start of the current step has been kept.
+	double					 m_startTime{ 0 };
+	BodyState				 m_start;
+	BodyState				 m_interpolated;
+
+	bool everyStep() const;
+	double nextTime() const;
+	void advance(double inTime);
+
+public:
+	explicit OutputSchedule(const SimulationSettings& inSettings);
+
+	//Write any snapshots due at the start of the simulation, which is only the case if time zero is listed.
+	void writeStart(double inTime, const BodyState& inState, TrajectoryWriter& outWriter);
+	//Called before each step from inStartTime to inEndTime, to keep the state at the start of it if a snapshot falls inside the step.
+	void beginStep(double inStartTime, double inEndTime, const BodyState& inState);
+	//Called after the step, to write every snapshot due up to its end.
+	void endStep(double inEndTime, const BodyState& inState, TrajectoryWriter& outWriter);
+	std::size_t written() const;
+};
+
+
+//Make the writer chosen by outputFormat in the settings, running on a thread of its own if asyncOutput is set.
+std::unique_ptr<TrajectoryWriter> makeTrajectoryWriter(const SimulationSettings& inSettings);
+
+//Turn a binary or compressed trajectory back into the CSV file the csv writer would have made with the same precision and time column, for tools which only read that.
+//A file cut short, such as by a run being stopped, is converted up to its last whole snapshot. Returns the number of snapshots converted.
+std::size_t convertBinaryToCsv(std::istream& inBinary, std::ostream& outCsv, int inPrecision = 0, bool inWriteTime = false);
+
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef SimulationSettings_H
+#define SimulationSettings_H
+
+#include <string>
+#include <cstddef>
+#include <vector>
+
+/*
+* Every simulation-wide setting which can be read from config.txt, along with its default value.
+* Gathered into one object so that the parts of the simulation which need them (solvers, integrators, output) can be built from a single source.
+*/
+
+struct SimulationSettings {
+	//The simulation configuration variables, measured in seconds.
+	double			 timeStep{ 1 };
+	double			 totalLength{ 10 };
+
+	//Time integration.
+	std::string		 integrator{ "eulerCromer" };		//Which integrator to use. See Integrator.h for the options.
+	double			 tolerance{ 1e-10 };				//The relative error allowed per step by the adaptive integrators.
+	double			 timestepAccuracy{ 0.02 };			//The fraction of |a|/|da/dt| each body may step by under the block time step and Hermite integrators.
+	double			 changeoverRadius{ 3 };				//How close two bodies come, in Hill radii, before the hybrid integrator treats them as an encounter.
+
+	//Force calculation.
+	std::string		 forceSolver{ "direct" };			//Which force solver to use. See ForceSolver.h for the options.
+	double			 theta{ 0.5 };						//The opening angle of the tree solvers.
+	bool			 quadrupole{ false };				//Whether the Barnes-Hut solver includes each cell's quadrupole moment.
+	std::size_t		 expansionOrder{ 4 };				//The order p of the Fast Multipole Method expansions.
+	std::string		 softening{ "none" };				//How close encounters are softened: none, plummer or spline. See ForceKernels.h.
+	double			 softeningLength{ 0 };				//The softening length of every body which does not give its own, measured in m.
+	bool			 accuracyReport{ false };			//Whether to compare the tree solver against direct summation before the simulation starts.
+	std::size_t		 threadCount{ 0 };					//How many threads the simulation may use. Zero means one per hardware thread.
+
+	//Bodies.
+	double			 passiveMassFraction{ 0 };			//Bodies lighter than this fraction of the total mass are made massless test particles. Zero turns this off.
+	bool			 absorbPassiveMass{ false };		//Whether the mass taken from those bodies is added to the most massive body.
+
+	//Output.
+	std::string		 outputFormat{ "csv" };				//How the trajectory is written: csv, binary or compressed. See Output.h.
+	int				 outputPrecision{ 0 };				//The significant digits of each number in csv output. Zero writes as many as are needed to read back the exact value.
+	double			 outputInterval{ 0 };				//The time between snapshots, measured in s. Zero writes every step.
+	std::vector<double>	 outputTimes;					//Times at which to write a snapshot as well, measured in s.
+	bool			 outputTime{ false };				//Whether each csv row starts with its time even when there is one row per step.
+	bool			 asyncOutput{ true };				//Whether the output is written on a thread of its own, overlapping with the simulation.
+	double			 outputMemory{ 64 };				//The most memory the snapshots waiting for that thread may take, measured in MB.
+
+	//Close encounters.
+	double			 encounterRadius{ 0 };				//Pairs of bodies closer than this, in m, are logged as close encounters. Zero turns detection off.
+	bool			 mergeEncounters{ false };			//Whether the bodies in a close encounter are merged into one.
+};
+
+
+#endif
@@ -9,10 +9,22 @@
 #include <charconv>		//To read string_views into numbers
 #include <bitset>		//Used to track properly initialised components of a planet.
 #include <array>		//Used to track how far along the simulation is
+#include <memory>
+#include <vector>
+#include <stdexcept>
 
 
 #include "PhysicsVector.h"
 #include "Planet.h"
+#include "BodySystem.h"
+#include "ForceKernels.h"
+#include "ForceSolver.h"
+#include "BarnesHut.h"
+#include "Integrator.h"
+#include "Encounters.h"
+#include "Output.h"
+#include "SimulationSettings.h"
+#include "ThreadPool.h"
 
 //To prevent confusion between a vector, the mathematical object of a number with direction, and std::vector, we use this alias.
 using planetArray_t = std::vector<Planet>;
@@ -38,23 +50,6 @@ void importDefaultData(planetArray_t& inPlanets) {
 
 
 
-//This method calculates the position of the center of mass of the system. This is given by Sum(mass_n * position_n)/Sum(mass_n). 
-//Since we're dealing with vectors, we need to do this on a per-component basis.
-vector3D_t centreOfMass(const planetArray_t& Planets) {
-	double comX{ 0 };
-	double comY{ 0 };
-	double comZ{ 0 };
-	double totalMass{ 0 };
-	for (auto planet : Planets) {
-		comX += planet.getPosition().x() * planet.getMass();		//Sum the individual mass*position terms for the numerator
-		comY += planet.getPosition().y() * planet.getMass();
-		comZ += planet.getPosition().z() * planet.getMass();
-		totalMass += planet.getMass();								//Sum the masses for the denominator
-	}
-	vector3D_t centreOfMass{ comX / totalMass, comY / totalMass, comZ / totalMass };
-	return centreOfMass;	
-}
-
 //This function makes use of std::from_chars to read a double value from a string_view.
 double readChars(const std::string_view& inString) {
 	double outputNumber;
@@ -122,12 +117,50 @@ void readVector(std::string_view inString, vector3D_t& finalVector) {
 	}
 }
 
+//Read a comma separated list of numbers, such as "86400,172800,259200", with or without brackets around it. The numbers are added to outList.
+void readList(std::string_view inString, std::vector<double>& outList) {
+	if (!inString.empty() && inString[0] == '(')inString.remove_prefix(1);
+	if (!inString.empty() && inString[inString.length() - 1] == ')')inString.remove_suffix(1);
+	while (!inString.empty()) {
+		const auto comma{ inString.find(',') };
+		outList.push_back(readChars(inString.substr(0, comma)));
+		if (comma == std::string_view::npos) break;
+		inString.remove_prefix(comma + 1);
+	}
+}
+
 
-int main()
+int main(int argc, char* argv[])
 {
-	//The simulation configuration variables, measured in seconds.
-	double timeStep{ 1 };		
-	double totalLength{ 10 };	
+	//Run as "SolarSystem convert <binary file> [csv file] [precision] [time]" to turn a binary or compressed trajectory into the CSV file the simulation writes by default, rather than simulating.
+	//The precision is the number of significant digits, as with outputPrecision in config.txt, and by default every number is written in full.
+	//A time of 1 starts each row with its time, as the csv writer does with outputTime, outputInterval or outputTimes. By default the rows are one per step and carry no time.
+	if (argc >= 3 && std::string_view{ argv[1] } == "convert") {
+		const std::string binaryName{ argv[2] };
+		const std::string csvName{ argc >= 4 ? argv[3] : binaryName.substr(0, binaryName.find_last_of('.')) + ".csv" };
+		std::ifstream binaryFile(binaryName, std::ios::binary);
+		if (!binaryFile) {
+			std::cerr << "Binary trajectory " << binaryName << " could not be opened.\n";
+			throw std::invalid_argument("Error: binary trajectory could not be opened");
+		}
+		std::ofstream csvFile(csvName);
+		if (!csvFile) {
+			std::cerr << "CSV file " << csvName << " could not be opened for writing.\n";
+			throw std::invalid_argument("Error: CSV file could not be opened");
+		}
+		const int precision{ argc >= 5 ? static_cast<int>(readChars(argv[4])) : 0 };
+		const bool writeTime{ argc >= 6 && readChars(argv[5]) != 0 };
+		const std::size_t snapshots{ convertBinaryToCsv(binaryFile, csvFile, precision, writeTime) };
+		if (!csvFile.flush()) {
+			std::cerr << "CSV file " << csvName << " could not be written in full.\n";
+			throw std::runtime_error("Error: CSV file could not be written");
+		}
+		std::cout << "Converted " << snapshots << " snapshots from " << binaryName << " to " << csvName << '\n';
+		return 0;
+	}
+
+	//The simulation configuration variables. See SimulationSettings.h for their defaults.
+	SimulationSettings settings;
 
 	planetArray_t Planets{};
 
@@ -145,6 +178,8 @@ int main()
 	double newMass;											//Its mass
 	vector3D_t newPos;										//Position
 	vector3D_t newVel;										//And velocity.
+	double newSoftening{ -1 };								//An optional softening length for the planet. Negative means it takes the default.
+	std::vector<double> planetSoftening;					//The softening length given to each planet, in the same order as Planets.
 
 	//Then we loop through the file.
 	while (getline(configFile, inputLine)) {
@@ -163,8 +198,31 @@ int main()
 		lineAfterEquals.remove_prefix(splitPos+1);
 		
 		//Once we have separated out our lines, we can start processing them. We start with our simulation constants.
-		if (lineBeforeEquals == "timeStep") timeStep = readChars(lineAfterEquals);
-		else if (lineBeforeEquals == "simulationLength")totalLength = readChars(lineAfterEquals);
+		if (lineBeforeEquals == "timeStep") settings.timeStep = readChars(lineAfterEquals);
+		else if (lineBeforeEquals == "simulationLength")settings.totalLength = readChars(lineAfterEquals);
+		else if (lineBeforeEquals == "integrator")settings.integrator = lineAfterEquals;
+		else if (lineBeforeEquals == "tolerance")settings.tolerance = readChars(lineAfterEquals);
+		else if (lineBeforeEquals == "changeoverRadius")settings.changeoverRadius = readChars(lineAfterEquals);
+		else if (lineBeforeEquals == "timestepAccuracy")settings.timestepAccuracy = readChars(lineAfterEquals);
+		else if (lineBeforeEquals == "forceSolver")settings.forceSolver = lineAfterEquals;
+		else if (lineBeforeEquals == "theta")settings.theta = readChars(lineAfterEquals);
+		else if (lineBeforeEquals == "quadrupole")settings.quadrupole = readChars(lineAfterEquals) != 0;
+		else if (lineBeforeEquals == "softening")settings.softening = lineAfterEquals;
+		else if (lineBeforeEquals == "softeningLength")settings.softeningLength = readChars(lineAfterEquals);
+		else if (lineBeforeEquals == "expansionOrder")settings.expansionOrder = static_cast<std::size_t>(readChars(lineAfterEquals));
+		else if (lineBeforeEquals == "accuracyReport")settings.accuracyReport = readChars(lineAfterEquals) != 0;
+		else if (lineBeforeEquals == "threads")settings.threadCount = static_cast<std::size_t>(readChars(lineAfterEquals));
+		else if (lineBeforeEquals == "passiveMassFraction")settings.passiveMassFraction = readChars(lineAfterEquals);
+		else if (lineBeforeEquals == "absorbPassiveMass")settings.absorbPassiveMass = readChars(lineAfterEquals) != 0;
+		else if (lineBeforeEquals == "outputFormat")settings.outputFormat = lineAfterEquals;
+		else if (lineBeforeEquals == "outputPrecision")settings.outputPrecision = static_cast<int>(readChars(lineAfterEquals));
+		else if (lineBeforeEquals == "outputInterval")settings.outputInterval = readChars(lineAfterEquals);
+		else if (lineBeforeEquals == "outputTimes")readList(lineAfterEquals, settings.outputTimes);
+		else if (lineBeforeEquals == "outputTime")settings.outputTime = readChars(lineAfterEquals) != 0;
+		else if (lineBeforeEquals == "asyncOutput")settings.asyncOutput = readChars(lineAfterEquals) != 0;
+		else if (lineBeforeEquals == "outputMemory")settings.outputMemory = readChars(lineAfterEquals);
+		else if (lineBeforeEquals == "encounterRadius")settings.encounterRadius = readChars(lineAfterEquals);
+		else if (lineBeforeEquals == "mergeEncounters")settings.mergeEncounters = readChars(lineAfterEquals) != 0;
 		//If we get this far we are probably creating a new planet.			
 		else if (lineBeforeEquals == "name") {
 			newName = lineAfterEquals;
@@ -182,6 +240,18 @@ int main()
 			readVector(lineAfterEquals, newVel);
 			initialisedComponents.set(3, true);
 		}
+		//The optional softening length belongs to the planet being read, wherever it comes in that planet's block.
+		else if (lineBeforeEquals == "bodySoftening") {
+			if (newSoftening >= 0) {
+				std::cerr << "Error in config file: A planet's block gives bodySoftening more than once.\n";
+				throw std::invalid_argument("Error in config file: Repeated bodySoftening");
+			}
+			newSoftening = readChars(lineAfterEquals);
+			if (newSoftening < 0) {
+				std::cerr << "Error in config file: bodySoftening " << newSoftening << " is negative.\n";
+				throw std::invalid_argument("Error in config file: Invalid bodySoftening");
+			}
+		}
 		//If we skip past those and we can't identify what lineBeforeEquals says, we have a problem.
 		else {
 			std::cerr << "Error in config file: Line " << lineBeforeEquals << " does not match an expected value.\n";
@@ -193,11 +263,20 @@ int main()
 		//If all four planet variables have been properly set, our initialisedComponents bitset will be all true.
 		if (initialisedComponents.all()) {			
 			Planets.push_back(Planet(newName, newMass, newPos, newVel));	//So we make the new planet
+			planetSoftening.push_back(newSoftening);
 			initialisedComponents.reset();									//And reset the bitset.
+			newSoftening = -1;
 		}
 
 	}
+	//A softening length left over once the file ends was not inside any planet's block, so there is no planet it could be meant for.
+	if (newSoftening >= 0) {
+		std::cerr << "Error in config file: bodySoftening must be inside a planet's block, with its name, mass, position and velocity.\n";
+		throw std::invalid_argument("Error in config file: bodySoftening outside a planet");
+	}
 
+	const double timeStep{ settings.timeStep };
+	const double totalLength{ settings.totalLength };
 	std::cout << "Simulation time step : " << timeStep << '\t' << "Simulation total simulated length: "<<totalLength << '\n';
 
 	if (Planets.size() == 0) {
@@ -208,16 +287,65 @@ int main()
 	else {
 		std::cout << "Planets being simulated: " << Planets.size() << '\n';
 	}
+	//Now we have read in every planet, we move them into the structure-of-arrays container which the simulation actually runs on,
+	//along with their softening lengths. The default planets have none of their own.
+	planetSoftening.resize(Planets.size(), -1);
+	BodySystem Bodies;
+	Bodies.reserve(Planets.size());
+	for (std::size_t i = 0; i < Planets.size(); ++i) {
+		const double softening{ planetSoftening[i] < 0 ? settings.softeningLength : planetSoftening[i] };
+		Bodies.addBody(Planets[i].getName(), Planets[i].getMass(), Planets[i].getPosition(), Planets[i].getVelocity(), softening);
+	}
+	//Bodies too light to matter as sources are demoted to test particles before anything else is worked out, as absorbing their mass moves the centre of mass.
+	const std::size_t passiveCount{ Bodies.makeLightBodiesPassive(settings.passiveMassFraction, settings.absorbPassiveMass) };
+	if (passiveCount > 0) {
+		std::cout << passiveCount << " bodies below " << settings.passiveMassFraction << " of the total mass are treated as test particles"
+			<< (settings.absorbPassiveMass ? ", with their mass added to the heaviest body.\n" : ".\n");
+	}
+	if (Bodies.testParticleCount() > 0) {
+		std::cout << "Massive bodies: " << Bodies.activeCount() << '\t' << "Massless test particles: " << Bodies.testParticleCount() << '\n';
+	}
+
+	//In reality, the planets don't orbit the exact center of the sun. They orbit the system's joint center of mass.
+	//By far the simplest way to implement this is set the center of mass at the origin of the system, and move everything else in the universe around to accommodate.
+	//Its velocity is taken away too, so that it stays there for the whole simulation, and integrators which keep their own copy of the state are never moved under their feet.
+	Bodies.moveToCentreOfMassFrame();
 
-	//Create our outputfile
-	std::string outputFileName{ "cppOutputFile.csv" };
-	std::ofstream outputFile(outputFileName);
+	//Start the worker threads. They are created once here and reused for every step.
+	ThreadPool pool{ settings.threadCount };
+	std::cout << "Threads: " << pool.size() << '\n';
 
-	//Write column headers to the output file
-	for (auto& planet : Planets) {
-		outputFile << planet.getName() << "X," << planet.getName() << "Y," << planet.getName() << "Z,";
+	//Set up the force solver.
+	const std::unique_ptr<ForceSolver> solver{ makeForceSolver(settings, pool) };
+	std::cout << "Force solver: " << solver->name() << '\t' << "Force kernel instruction set: " << instructionSetName(activeInstructionSet()) << '\n';
+	if (solver->softening() != Softening::none) {
+		std::cout << "Softening: " << softeningName(solver->softening()) << '\t' << "Default softening length: " << settings.softeningLength << '\n';
 	}
-	outputFile << '\n';
+	if (settings.accuracyReport) reportBarnesHutAccuracy(Bodies, std::cout, pool);
+
+	//And the integrator which uses it.
+	const std::unique_ptr<Integrator> integrator{ makeIntegrator(settings, pool) };
+	std::cout << "Integrator: " << integrator->name() << '\n';
+
+	//Create our output file, and describe the bodies in it. Merging bodies changes them, so they are described again after each merge too.
+	const std::unique_ptr<TrajectoryWriter> output{ makeTrajectoryWriter(settings) };
+	output->writeBodies(Bodies.names(), Bodies.masses());
+	//Snapshots are written every step unless outputInterval or outputTimes say otherwise.
+	OutputSchedule outputSchedule{ settings };
+
+	//Close encounters are looked for after every step, if enabled, and written to a log of their own.
+	std::unique_ptr<EncounterDetector> encounterDetector;
+	std::ofstream encounterFile;
+	const std::string encounterFileName{ "encounters.csv" };
+	if (settings.encounterRadius > 0) {
+		encounterDetector = std::make_unique<EncounterDetector>(settings.encounterRadius, pool);
+		encounterFile.open(encounterFileName);
+		encounterFile << "time,first,second,distance,merged\n";
+		std::cout << "Close encounters within " << settings.encounterRadius << " m are logged to " << encounterFileName
+			<< (settings.mergeEncounters ? ", and the bodies merged.\n" : ".\n");
+	}
+	std::size_t encounterCount{ 0 };
+	std::size_t mergeCount{ 0 };
 
 	//As we are potentially simulating a lot of planets over a long period of time, it might be nice to know how far along the simulation is.
 	std::array<double, 100> percentageMarkers;	//A measure of how far along the simulation is. entry [0] -> 1%, [1] -> 2% etc.
@@ -233,6 +361,7 @@ int main()
 
 	int currentPercent{ 0 };	//Used as a tracker to prevent needing to search the entire percentageMarkers for how far along we are every run.
 	double currentLength{ 0 };
+	outputSchedule.writeStart(currentLength, Bodies.state(), *output);
 	while(currentLength<totalLength){
 		//First, process how far along we are:
 		if (currentLength > percentageMarkers[currentPercent] && hasbeenPrinted[currentPercent]==false && currentPercent<99) {	//currentPercent <99 to prevent access violation
@@ -244,30 +373,50 @@ int main()
 
 
 
-		//In reality, the planets don't orbit the exact center of the sun. They orbit the system's joint center of mass.
-		//By far the simplest way to implement this is set the center of mass at the origin of the system, and move everything else in the universe around to accommodate.
-		vector3D_t CoM{ centreOfMass(Planets) };
-		for (auto& planet : Planets) {
-			planet.setPosition(planet.getPosition() - CoM);
-		}
-
-		//Update the planet following the Euler Cromer method.
-		for (auto& planet : Planets) {
-			planet.updateEulerCromer(Planets, timeStep);
-		}
-
-		//And write the updated data to the output file.
-		for (const auto& planet : Planets) {
-			outputFile << planet.getPosition().x() << "," << planet.getPosition().y() << ',' << planet.getPosition().z() << ',';
-		}
-		outputFile <<  '\n';
+		//Update the planets using whichever integrator was chosen, and write the positions at any output times passed on the way.
+		//This comes before any merges, which happen at the end of the step, as the positions at times during the step are worked out from the bodies at both ends of it.
+		outputSchedule.beginStep(currentLength, currentLength + timeStep, Bodies.state());
+		integrator->step(Bodies, *solver, timeStep);
 		currentLength += timeStep;
-		
+		outputSchedule.endStep(currentLength, Bodies.state(), *output);
+
+		//Look for close encounters. Only the first check at which a pair is close is logged, unless the pair is merged.
+		if (encounterDetector) {
+			std::vector<Encounter>& encounters{ encounterDetector->findEncounters(Bodies) };
+			if (!encounters.empty()) {
+				//Merging removes bodies, so their names are kept aside for the log first.
+				std::vector<std::string> names;
+				std::size_t merges{ 0 };
+				if (settings.mergeEncounters) {
+					names = Bodies.names();
+					merges = mergeEncounters(Bodies, encounters);
+				}
+				const std::vector<std::string>& logNames{ settings.mergeEncounters ? names : Bodies.names() };
+				for (const Encounter& encounter : encounters) {
+					if (!encounter.isNew && !encounter.merged) continue;
+					encounterFile << currentLength << ',' << logNames[encounter.first] << ',' << logNames[encounter.second] << ',' << encounter.distance << ','
+						<< encounter.merged << '\n';
+					++encounterCount;
+				}
+				if (merges > 0) {
+					//The integrator's own copy of the bodies is out of date, and every index after a removed body has shifted.
+					integrator->reset();
+					encounterDetector->forgetEncounters();
+					output->writeBodies(Bodies.names(), Bodies.masses());
+					mergeCount += merges;
+				}
+			}
+		}
 	}
 
-	std::cout << "100% complete.\nData written to " << outputFileName << '\n';
+	output->finish();
+	std::cout << "100% complete.\nData written to " << output->fileName() << ": " << outputSchedule.written() << " snapshots.\n";
+	integrator->printStatistics(std::cout);
+	output->printStatistics(std::cout);
+	if (encounterDetector) {
+		std::cout << "Close encounters: " << encounterCount << ", of which merged: " << mergeCount << ". Logged to " << encounterFileName << '\n';
+	}
 
-	outputFile.close();
 	
 
 }
@@ -0,0 +1,115 @@
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+namespace {
+	//Set on any thread which is currently working through a pool's tasks, so that nested calls run inline rather than waiting on themselves.
+	thread_local bool t_insidePool{ false };
+}
+
+
+ThreadPool::ThreadPool(std::size_t inThreadCount) {
+	std::size_t threadCount{ inThreadCount };
+	if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0) threadCount = 1;											//hardware_concurrency() is allowed to return 0 if it cannot tell.
+
+	//The calling thread is the first of the threads, so only threadCount - 1 workers are needed.
+	m_workers.reserve(threadCount - 1);
+	for (std::size_t t = 1; t < threadCount; ++t) m_workers.emplace_back([this]() { workerLoop(); });
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (auto& worker : m_workers) worker.join();
+}
+
+std::size_t ThreadPool::size() const {
+	return m_workers.size() + 1;
+}
+
+void ThreadPool::workerLoop() {
+	t_insidePool = true;
+	std::size_t seenGeneration{ 0 };
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock{ m_mutex };
+			m_wake.wait(lock, [&]() { return m_stopping || m_generation != seenGeneration; });
+			if (m_stopping) return;
+			seenGeneration = m_generation;
+		}
+
+		claimTasks();
+
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		if (--m_busyWorkers == 0) m_finished.notify_one();
+	}
+}
+
+//Take tasks one at a time until there are none left. Shared by the workers and the calling thread.
+void ThreadPool::claimTasks() {
+	for (std::size_t t = m_nextTask++; t < m_taskCount; t = m_nextTask++) {
+		try {
+			(*m_task)(t);
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			if (!m_exception) m_exception = std::current_exception();
+		}
+	}
+}
+
+void ThreadPool::run(std::size_t inTaskCount, const task_t& inTask) {
+	if (inTaskCount == 0) return;
+
+	//With a single task, no workers, or from inside another task, waking the workers would only cost time.
+	if (inTaskCount == 1 || m_workers.empty() || t_insidePool) {
+		for (std::size_t t = 0; t < inTaskCount; ++t) inTask(t);
+		return;
+	}
+
+	std::lock_guard<std::mutex> runLock{ m_runMutex };
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_task = &inTask;
+		m_taskCount = inTaskCount;
+		m_nextTask = 0;
+		m_busyWorkers = m_workers.size();
+		m_exception = nullptr;
+		++m_generation;
+	}
+	m_wake.notify_all();
+
+	t_insidePool = true;
+	claimTasks();
+	t_insidePool = false;
+
+	//The barrier. Every worker has to check in, even those which found no tasks left, before inTask can go out of scope.
+	std::unique_lock<std::mutex> lock{ m_mutex };
+	m_finished.wait(lock, [&]() { return m_busyWorkers == 0; });
+	m_task = nullptr;
+	if (m_exception) std::rethrow_exception(m_exception);
+}
+
+void ThreadPool::parallelFor(std::size_t inCount, std::size_t inGrain, const range_t& inBody) {
+	if (inCount == 0) return;
+	const std::size_t grain{ std::max<std::size_t>(inGrain, 1) };
+
+	//Aim for about four blocks per thread, rounded up to a whole number of grains so that vectorised loops keep their alignment.
+	std::size_t blockSize{ (inCount + 4 * size() - 1) / (4 * size()) };
+	blockSize = std::max(grain, (blockSize + grain - 1) / grain * grain);
+	const std::size_t blockCount{ (inCount + blockSize - 1) / blockSize };
+
+	run(blockCount, [&](std::size_t inBlock) {
+		const std::size_t begin{ inBlock * blockSize };
+		inBody(begin, std::min(inCount, begin + blockSize));
+	});
+}
+
+ThreadPool& ThreadPool::serial() {
+	static ThreadPool pool{ 1 };
+	return pool;
+}
@@ -0,0 +1,70 @@
+#ifndef ThreadPool_H
+#define ThreadPool_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+* A fixed set of worker threads, created once at startup and reused for every step of the simulation.
+* Starting fresh threads for every force calculation costs tens of microseconds each time, which adds up over millions of steps.
+*
+* Work is handed over as a number of tasks. The calling thread works through them alongside the workers, and run() returns only once every task has finished,
+* so each call acts as a barrier between one phase of a step and the next. Tasks are claimed in any order, so a task must only write to data that belongs to it.
+*
+* A pool may be given work from several threads at once, but the calls take turns. If a task itself asks the pool for more work, that work is done inline on
+* the thread that asked, so nested parallel loops never deadlock.
+*/
+
+class ThreadPool
+{
+public:
+	using task_t = std::function<void(std::size_t)>;
+	using range_t = std::function<void(std::size_t, std::size_t)>;
+
+private:
+	std::vector<std::thread>	 m_workers;
+
+	std::mutex					 m_runMutex;				//Held for the whole of a run(), so only one caller uses the workers at a time.
+	std::mutex					 m_mutex;					//Guards everything below.
+	std::condition_variable		 m_wake;
+	std::condition_variable		 m_finished;
+	const task_t*				 m_task{ nullptr };
+	std::size_t					 m_taskCount{ 0 };
+	std::atomic<std::size_t>	 m_nextTask{ 0 };
+	std::size_t					 m_generation{ 0 };			//Bumped every run(), so a worker knows there is new work.
+	std::size_t					 m_busyWorkers{ 0 };
+	std::exception_ptr			 m_exception;				//The first exception thrown by a task, rethrown to the caller.
+	bool						 m_stopping{ false };
+
+	void workerLoop();
+	void claimTasks();
+
+public:
+	//Create a pool with inThreadCount threads in total, including the one which calls run(). Zero means one per hardware thread.
+	explicit ThreadPool(std::size_t inThreadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	//The number of threads work is shared between, including the caller.
+	std::size_t size() const;
+
+	//Call inTask(t) for every t in [0, inTaskCount), and wait for them all to finish.
+	void run(std::size_t inTaskCount, const task_t& inTask);
+	//Split [0, inCount) into contiguous blocks of at least inGrain items and call inBody(begin, end) on each, then wait for them all to finish.
+	//The blocks are sized so that every thread gets a few, which evens out blocks that take longer than others.
+	void parallelFor(std::size_t inCount, std::size_t inGrain, const range_t& inBody);
+
+	//A shared pool with no workers, which does everything on the calling thread. Used by solvers and systems which are not given a pool of their own.
+	static ThreadPool& serial();
+};
+
+
+#endif
@@ -0,0 +1,162 @@
+#include <algorithm>
+
+#include "WisdomHolman.h"
+#include "Kepler.h"
+
+namespace {
+	constexpr std::size_t updateGrain{ 4096 };
+	//Solving Kepler's equation costs a few hundred operations a body, so far smaller blocks are worth sharing out.
+	constexpr std::size_t keplerGrain{ 256 };
+}
+
+
+WisdomHolmanIntegrator::WisdomHolmanIntegrator(ThreadPool& inPool) : Integrator{ inPool } {}
+
+void WisdomHolmanIntegrator::step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) {
+	if (!m_initialised) initialise(inBodies, inSolver);
+
+	kick(0.5 * inTimeStep);
+	jump(0.5 * inTimeStep);
+	keplerDrift(inTimeStep);
+	jump(0.5 * inTimeStep);
+	computeAccelerations(inSolver, m_planets, m_heliocentric, m_interaction);
+	kick(0.5 * inTimeStep);
+
+	for (std::size_t axis = 0; axis < 3; ++axis) m_barycentre[axis] += m_barycentreVelocity[axis] * inTimeStep;
+	writeState(inBodies);
+	++m_steps;
+}
+
+void WisdomHolmanIntegrator::initialise(const BodySystem& inBodies, const ForceSolver& inSolver) {
+	const std::size_t count{ inBodies.size() };
+	const BodyState& state{ inBodies.state() };
+	const alignedArray_t<double>& mass{ inBodies.masses() };
+
+	m_central = static_cast<std::size_t>(std::max_element(mass.begin(), mass.end()) - mass.begin());
+	m_centralMass = mass[m_central];
+
+	m_totalMass = 0;
+	double momentum[3]{};
+	for (std::size_t axis = 0; axis < 3; ++axis) m_barycentre[axis] = 0;
+	for (std::size_t i = 0; i < count; ++i) {
+		m_totalMass += mass[i];
+		m_barycentre[0] += mass[i] * state.x[i];
+		m_barycentre[1] += mass[i] * state.y[i];
+		m_barycentre[2] += mass[i] * state.z[i];
+		momentum[0] += mass[i] * state.vx[i];
+		momentum[1] += mass[i] * state.vy[i];
+		momentum[2] += mass[i] * state.vz[i];
+	}
+	for (std::size_t axis = 0; axis < 3; ++axis) {
+		m_barycentre[axis] /= m_totalMass;
+		m_barycentreVelocity[axis] = momentum[axis] / m_totalMass;
+	}
+
+	m_heliocentric.resize(count);
+	for (std::size_t i = 0; i < count; ++i) {
+		m_heliocentric.x[i] = state.x[i] - state.x[m_central];
+		m_heliocentric.y[i] = state.y[i] - state.y[m_central];
+		m_heliocentric.z[i] = state.z[i] - state.z[m_central];
+		m_heliocentric.vx[i] = i == m_central ? 0 : state.vx[i] - m_barycentreVelocity[0];
+		m_heliocentric.vy[i] = i == m_central ? 0 : state.vy[i] - m_barycentreVelocity[1];
+		m_heliocentric.vz[i] = i == m_central ? 0 : state.vz[i] - m_barycentreVelocity[2];
+	}
+
+	m_planets = inBodies;
+	m_planets[m_central].setMass(0);
+	computeAccelerations(inSolver, m_planets, m_heliocentric, m_interaction);
+	m_initialised = true;
+}
+
+//The pulls of the planets on each other. The central body's entry is left alone, as its velocity is not part of the heliocentric state.
+void WisdomHolmanIntegrator::kick(double inTime) {
+	m_pool->parallelFor(m_heliocentric.size(), updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		for (std::size_t i = inBegin; i < inEnd; ++i) {
+			if (i == m_central) continue;
+			m_heliocentric.vx[i] += m_interaction.ax[i] * inTime;
+			m_heliocentric.vy[i] += m_interaction.ay[i] * inTime;
+			m_heliocentric.vz[i] += m_interaction.az[i] * inTime;
+		}
+	});
+}
+
+//The central body's motion about the barycentre, as seen from the central body: every planet moves by the planets' total momentum over the central mass.
+void WisdomHolmanIntegrator::jump(double inTime) {
+	const std::size_t count{ m_heliocentric.size() };
+	const alignedArray_t<double>& mass{ m_planets.masses() };
+	double momentum[3]{};
+	for (std::size_t i = 0; i < count; ++i) {
+		momentum[0] += mass[i] * m_heliocentric.vx[i];
+		momentum[1] += mass[i] * m_heliocentric.vy[i];
+		momentum[2] += mass[i] * m_heliocentric.vz[i];
+	}
+	const double shiftX{ momentum[0] / m_centralMass * inTime };
+	const double shiftY{ momentum[1] / m_centralMass * inTime };
+	const double shiftZ{ momentum[2] / m_centralMass * inTime };
+
+	m_pool->parallelFor(count, updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		for (std::size_t i = inBegin; i < inEnd; ++i) {
+			if (i == m_central) continue;
+			m_heliocentric.x[i] += shiftX;
+			m_heliocentric.y[i] += shiftY;
+			m_heliocentric.z[i] += shiftZ;
+		}
+	});
+}
+
+//Every body but the central one follows its Kepler orbit. The central body sits at the origin of these coordinates, so it splits the arrays into two runs.
+void WisdomHolmanIntegrator::keplerDrift(double inTime) {
+	const double mu{ BodySystem::G * m_centralMass };
+	BodyState& state{ m_heliocentric };
+	m_pool->parallelFor(state.size(), keplerGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		const auto driftRun = [&](std::size_t inRunBegin, std::size_t inRunEnd) {
+			if (inRunBegin >= inRunEnd) return;
+			Kepler::drift(mu, inTime, inRunEnd - inRunBegin, state.x.data() + inRunBegin, state.y.data() + inRunBegin, state.z.data() + inRunBegin,
+				state.vx.data() + inRunBegin, state.vy.data() + inRunBegin, state.vz.data() + inRunBegin);
+		};
+		driftRun(inBegin, std::min(inEnd, m_central));
+		driftRun(std::max(inBegin, m_central + 1), inEnd);
+	});
+}
+
+void WisdomHolmanIntegrator::writeState(BodySystem& outBodies) const {
+	const std::size_t count{ m_heliocentric.size() };
+	const alignedArray_t<double>& mass{ m_planets.masses() };
+	double weightedPosition[3]{};
+	double momentum[3]{};
+	for (std::size_t i = 0; i < count; ++i) {
+		weightedPosition[0] += mass[i] * m_heliocentric.x[i];
+		weightedPosition[1] += mass[i] * m_heliocentric.y[i];
+		weightedPosition[2] += mass[i] * m_heliocentric.z[i];
+		momentum[0] += mass[i] * m_heliocentric.vx[i];
+		momentum[1] += mass[i] * m_heliocentric.vy[i];
+		momentum[2] += mass[i] * m_heliocentric.vz[i];
+	}
+
+	//The central body sits where the barycentre must be for the planets' positions, and moves to balance their momentum.
+	const double centralX{ m_barycentre[0] - weightedPosition[0] / m_totalMass };
+	const double centralY{ m_barycentre[1] - weightedPosition[1] / m_totalMass };
+	const double centralZ{ m_barycentre[2] - weightedPosition[2] / m_totalMass };
+
+	BodyState& state{ outBodies.state() };
+	m_pool->parallelFor(count, updateGrain, [&](std::size_t inBegin, std::size_t inEnd) {
+		for (std::size_t i = inBegin; i < inEnd; ++i) {
+			state.x[i] = m_heliocentric.x[i] + centralX;
+			state.y[i] = m_heliocentric.y[i] + centralY;
+			state.z[i] = m_heliocentric.z[i] + centralZ;
+			state.vx[i] = m_heliocentric.vx[i] + m_barycentreVelocity[0];
+			state.vy[i] = m_heliocentric.vy[i] + m_barycentreVelocity[1];
+			state.vz[i] = m_heliocentric.vz[i] + m_barycentreVelocity[2];
+		}
+	});
+	state.vx[m_central] = m_barycentreVelocity[0] - momentum[0] / m_centralMass;
+	state.vy[m_central] = m_barycentreVelocity[1] - momentum[1] / m_centralMass;
+	state.vz[m_central] = m_barycentreVelocity[2] - momentum[2] / m_centralMass;
+}
+
+void WisdomHolmanIntegrator::reset() {
+	m_initialised = false;
+}
+std::string_view WisdomHolmanIntegrator::name() const {
+	return "wisdomHolman";
+}
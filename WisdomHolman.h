@@ -0,0 +1,69 @@
+#ifndef WisdomHolman_H
+#define WisdomHolman_H
+
+#include <cstddef>
+
+#include "Integrator.h"
+
+/*
+* The Wisdom-Holman mixed-variable symplectic integrator, for systems dominated by one central body such as the solar system.
+*
+* Almost all of a planet's motion is its Kepler orbit about the Sun, which can be solved exactly (see Kepler.h). Other integrators have to resolve that orbit with
+* many small steps. Wisdom-Holman splits the Hamiltonian into the Kepler orbits and the much smaller pulls of the planets on each other, moves each planet exactly
+* along its orbit, and only approximates the small part. The error is then proportional to the planets' masses relative to the Sun's as well as to dt^2,
+* so steps of around a twentieth of the innermost orbit are usual: 4 days for Mercury, where a leapfrog would need hours.
+*
+* The system is written in democratic heliocentric coordinates: positions relative to the central body, velocities relative to the barycentre.
+* In these the Hamiltonian has three parts, each of which can be advanced exactly on its own:
+*
+*	Kepler		Each planet orbits the central body, with the central body's mass alone.
+*	Interaction	The planets pull on each other (but not on the central body, which is already in the Kepler part). Only the velocities change.
+*	Jump		Every position moves by the total momentum of the planets divided by the central mass. Only the positions change.
+*
+* Each step is a half-step kick from the interactions, a half-step jump, a full Kepler step, another half-step jump and a closing half-step kick. The interactions at
+* the end of a step are those at the start of the next, so each step costs one force calculation, made with the central body's mass set to zero.
+*
+* The central body is whichever body is the most massive. Every other body is treated as orbiting it, so moons, whose orbits about their planet are nothing like
+* Kepler orbits about the Sun, need the same short steps as with any other integrator.
+*
+* The heliocentric state is carried from one step to the next rather than converted back each step, so call reset() if the bodies are changed between steps.
+*
+* References:
+*	Wisdom, J. and Holman, M. (1991). Symplectic maps for the N-body problem. AJ 102, 1528.
+*	Duncan, M. J., Levison, H. F. and Lee, M. H. (1998). A multiple time step symplectic algorithm for integrating close encounters. AJ 116, 2067.
+*	Rein, H. and Tamayo, D. (2015). WHFast: a fast and unbiased implementation of a symplectic Wisdom-Holman integrator. MNRAS 452, 376.
+*/
+
+class WisdomHolmanIntegrator : public Integrator
+{
+protected:
+	bool							 m_initialised{ false };
+	std::size_t						 m_central{ 0 };				//The index of the central body.
+	double							 m_centralMass{ 0 };
+	double							 m_totalMass{ 0 };
+	double							 m_barycentre[3]{};				//The position and velocity of the barycentre, which moves in a straight line.
+	double							 m_barycentreVelocity[3]{};
+
+	//Positions relative to the central body and velocities relative to the barycentre. The central body's own entries are kept at zero.
+	BodyState						 m_heliocentric;
+	//A copy of the system with the central body's mass set to zero, so the force solver gives the interaction accelerations alone.
+	BodySystem						 m_planets;
+	AccelerationBuffer				 m_interaction;
+
+	void initialise(const BodySystem& inBodies, const ForceSolver& inSolver);
+	void kick(double inTime);
+	void jump(double inTime);
+	void keplerDrift(double inTime);
+	//Convert the heliocentric state back to the positions and velocities of every body relative to the origin.
+	void writeState(BodySystem& outBodies) const;
+
+public:
+	explicit WisdomHolmanIntegrator(ThreadPool& inPool = ThreadPool::serial());
+
+	void step(BodySystem& inBodies, const ForceSolver& inSolver, double inTimeStep) override;
+	void reset() override;
+	std::string_view name() const override;
+};
+
+
+#endif